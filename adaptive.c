@@ -0,0 +1,376 @@
+/***************************************
+ *         ADAPTIVE DICTIONARY         *
+ *_____________________________________*
+ * - up to AD_PROMOTE words live in a  *
+ *   packed array: one tag byte per    *
+ *   word scanned 16 at a time, words  *
+ *   max_str apart in one block        *
+ * - past that it promotes to a small  *
+ *   hsh.c table (or redblack.c when   *
+ *   ordered) which grows as usual     *
+ * - falls back to the packed array    *
+ *   once it shrinks below AD_DEMOTE   *
+ *_____________________________________*
+ ***************************************/
+#include <string.h>
+#include "adaptive.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define AD_START 16     /*first packed capacity, multiple of 16*/
+#define AD_PROMOTE 64   /*more words than this leave the packed array*/
+#define AD_DEMOTE 16    /*fewer words than this come back to it*/
+#define AD_HSH_LEN AD_PROMOTE * 4
+#define IS_SMALL s->keys != NULL
+#define KEY(I) (s->keys + (size_t) (I) * s->max_str)
+
+/*packed array*/
+static unsigned char tag(char* v, int max_str);
+static int small_find(ad_dic* s, char* v, unsigned char t);
+static int small_slot(ad_dic* s, char* v);
+static void small_add(ad_dic* s, char* v);
+static void small_remove(ad_dic* s, int i);
+static void small_alloc(ad_dic* s, int cap);
+
+/*switching representation*/
+static void promote(ad_dic* s);
+static void demote(ad_dic* s);
+static void demote_word(char* v, void* arg);
+
+/*Create empty dic, ordered keeps words sorted and promotes to a tree*/
+ad_dic* ad_init(int size, bool ordered)
+{
+   ad_dic* dl = NULL;
+
+   if (size < 2){
+      ON_ERROR("Size must be 2 or greater\n");
+   }
+
+   dl = (ad_dic*) calloc(1, sizeof(ad_dic));
+   if (dl == NULL){
+      ON_ERROR("Creation of Dictionary Failed\n");
+   }
+
+   dl->max_str = size;
+   dl->ordered = ordered;
+   dl->num_elem = 0;
+   small_alloc(dl, AD_START);
+
+   return dl;
+}
+
+/* Add one element into the dic */
+void ad_insert(ad_dic* s, char* v)
+{
+   if ( s == NULL || v == NULL ){
+      return;
+   }
+
+   if ( strlen(v) < 1 ){
+      return;
+   }
+
+   if ( IS_SMALL ){
+      if ( small_find(s, v, tag(v, s->max_str)) >= 0 ){
+         return;
+      }
+      if ( s->num_elem < AD_PROMOTE ){
+         small_add(s, v);
+         return;
+      }
+      promote(s);
+   }
+
+   if ( s->t != NULL ){
+      rb_insert(s->t, v);
+      s->num_elem = s->t->num_nodes;
+   } else {
+      hsh_insert(s->h, v);
+      s->num_elem = s->h->num_elem;
+   }
+}
+
+/* Returns true if v is in the array, false elsewise */
+bool ad_isin(ad_dic* s, char* v)
+{
+   if ( s == NULL || v == NULL ){
+      return false;
+   }
+
+   if ( strlen(v) < 1 ){
+      return false;
+   }
+
+   if ( IS_SMALL ){
+      return small_find(s, v, tag(v, s->max_str)) >= 0 ? true : false;
+   }
+   if ( s->t != NULL ){
+      return rb_isin(s->t, v);
+   }
+   return hsh_isin(s->h, v);
+}
+
+/* Removes v, returns true if it was in the dic */
+bool ad_remove(ad_dic* s, char* v)
+{
+   int i;
+   bool removed;
+
+   if ( s == NULL || v == NULL ){
+      return false;
+   }
+
+   if ( strlen(v) < 1 ){
+      return false;
+   }
+
+   if ( IS_SMALL ){
+      i = small_find(s, v, tag(v, s->max_str));
+      if ( i < 0 ){
+         return false;
+      }
+      small_remove(s, i);
+      return true;
+   }
+
+   if ( s->t != NULL ){
+      removed = rb_remove(s->t, v);
+      s->num_elem = s->t->num_nodes;
+   } else {
+      removed = hsh_remove(s->h, v);
+      s->num_elem = s->h->num_elem;
+   }
+
+   if ( s->num_elem < AD_DEMOTE ){
+      demote(s);
+   }
+   return removed;
+}
+
+/* Calls f on every word, in sorted order if the dic is ordered */
+void ad_foreach(ad_dic* s, void (*f)(char* v, void* arg), void* arg)
+{
+   int i;
+
+   if ( s == NULL || f == NULL ){
+      return;
+   }
+
+   if ( IS_SMALL ){
+      for (i = 0; i < s->num_elem; i++){
+         f(KEY(i), arg);
+      }
+   } else if ( s->t != NULL ){
+      rb_foreach(s->t, f, arg);
+   } else {
+      hsh_foreach(s->h, f, arg);
+   }
+}
+
+/* Number of words in the dic, O(1) */
+int ad_size(ad_dic* s)
+{
+   if ( s == NULL ){
+      return 0;
+   }
+   return s->num_elem;
+}
+
+/* Clears all space used, and sets pointer to NULL */
+void ad_free(ad_dic** s)
+{
+   ad_dic* p_d;
+
+   if ( s == NULL ){
+      return;
+   }
+
+   p_d = *s;
+   if ( p_d == NULL ){
+      return;
+   }
+
+   free(p_d->tags);
+   free(p_d->keys);
+   if ( p_d->h != NULL ){
+      hsh_free(&p_d->h);
+   }
+   if ( p_d->t != NULL ){
+      rb_free(&p_d->t);
+   }
+
+   free(p_d);
+   *s = NULL;
+}
+
+static unsigned char tag(char* v, int max_str)
+{
+   /*one byte summary of the word, folded from a djb2 pass over
+     the max_str - 1 bytes that are stored and compared          */
+   unsigned long h = 5381;
+   int c, i;
+
+   for (i = 0; i < max_str - 1 && (c = (unsigned char) v[i]); i++){
+      h = ((h << 5) + h) + c;
+   }
+   return (unsigned char) (h ^ (h >> 8) ^ (h >> 16) ^ (h >> 24));
+}
+
+static int small_find(ad_dic* s, char* v, unsigned char t)
+{
+   /*index of v in the packed array, or -1*/
+   int i;
+   int n = s->num_elem;
+
+#if defined(__SSE2__)
+   int b;
+   unsigned int mask;
+   __m128i needle = _mm_set1_epi8((char) t);
+   __m128i block;
+
+   /*cap is a multiple of 16 so every load stays inside tags*/
+   for (i = 0; i < n; i += 16){
+      block = _mm_loadu_si128((const __m128i*) (s->tags + i));
+      mask = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+      if ( n - i < 16 ){
+         mask &= (1u << (n - i)) - 1;
+      }
+      while ( mask ){
+         b = __builtin_ctz(mask);
+         if ( strncmp(KEY(i + b), v, s->max_str - 1) == 0 ){
+            return i + b;
+         }
+         mask &= mask - 1;
+      }
+   }
+#else
+   for (i = 0; i < n; i++){
+      if ( s->tags[i] == t && strncmp(KEY(i), v, s->max_str - 1) == 0 ){
+         return i;
+      }
+   }
+#endif
+   return -1;
+}
+
+static int small_slot(ad_dic* s, char* v)
+{
+   /*where v goes: sorted position if ordered, else the end*/
+   int lo = 0, hi = s->num_elem, mid;
+
+   if ( !s->ordered ){
+      return s->num_elem;
+   }
+
+   while ( lo < hi ){
+      mid = (lo + hi) / 2;
+      if ( strncmp(KEY(mid), v, s->max_str - 1) < 0 ){
+         lo = mid + 1;
+      } else {
+         hi = mid;
+      }
+   }
+   return lo;
+}
+
+static void small_add(ad_dic* s, char* v)
+{
+   /*v must not already be in the packed array*/
+   int i;
+
+   if ( s->num_elem == s->cap ){
+      small_alloc(s, s->cap * 2);
+   }
+
+   i = small_slot(s, v);
+   if ( i < s->num_elem ){
+      memmove(KEY(i + 1), KEY(i), (size_t) (s->num_elem - i) * s->max_str);
+      memmove(s->tags + i + 1, s->tags + i, s->num_elem - i);
+   }
+
+   strncpy(KEY(i), v, s->max_str - 1);
+   KEY(i)[s->max_str - 1] = '\0';
+   s->tags[i] = tag(v, s->max_str);
+   s->num_elem++;
+}
+
+static void small_remove(ad_dic* s, int i)
+{
+   int last = s->num_elem - 1;
+
+   if ( s->ordered ){
+      memmove(KEY(i), KEY(i + 1), (size_t) (last - i) * s->max_str);
+      memmove(s->tags + i, s->tags + i + 1, last - i);
+   } else if ( i != last ){
+      /*order doesn't matter, fill the hole with the last word*/
+      memcpy(KEY(i), KEY(last), s->max_str);
+      s->tags[i] = s->tags[last];
+   }
+   s->num_elem--;
+}
+
+static void small_alloc(ad_dic* s, int cap)
+{
+   /*(re)size the packed array to hold cap words*/
+   unsigned char* tags;
+   char* keys;
+
+   tags = (unsigned char*) realloc(s->tags, cap);
+   if ( tags == NULL ){
+      ON_ERROR("Packed array tag allocation failed\n");
+   }
+   s->tags = tags;
+
+   keys = (char*) realloc(s->keys, (size_t) cap * s->max_str);
+   if ( keys == NULL ){
+      ON_ERROR("Packed array key allocation failed\n");
+   }
+   s->keys = keys;
+
+   s->cap = cap;
+}
+
+static void promote(ad_dic* s)
+{
+   int i;
+
+   if ( s->ordered ){
+      s->t = rb_init(s->max_str);
+      for (i = 0; i < s->num_elem; i++){
+         rb_insert(s->t, KEY(i));
+      }
+   } else {
+      s->h = hsh_init_len(s->max_str, AD_HSH_LEN);
+      for (i = 0; i < s->num_elem; i++){
+         hsh_insert(s->h, KEY(i));
+      }
+   }
+
+   free(s->tags);
+   free(s->keys);
+   s->tags = NULL;
+   s->keys = NULL;
+   s->cap = 0;
+}
+
+static void demote(ad_dic* s)
+{
+   s->num_elem = 0;
+   small_alloc(s, AD_START);
+
+   /*rb_foreach walks in order, so ordered dics append sorted*/
+   if ( s->t != NULL ){
+      rb_foreach(s->t, demote_word, s);
+      rb_free(&s->t);
+   } else {
+      hsh_foreach(s->h, demote_word, s);
+      hsh_free(&s->h);
+   }
+}
+
+static void demote_word(char* v, void* arg)
+{
+   small_add((ad_dic*) arg, v);
+}
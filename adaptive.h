@@ -0,0 +1,50 @@
+/**********************************
+ *   Adaptive Dictionary H file   *
+ *________________________________*
+ * small: packed array, tag scan  *
+ * large: hsh.c table, or         *
+ *        redblack.c if ordered   *
+ **********************************/
+#ifndef ADAPTIVE_H
+#define ADAPTIVE_H
+
+#include "dic.h"
+#include "hsh.h"
+#include "redblack.h"
+
+struct _ad_dic {
+   int max_str;
+   int num_elem;
+   bool ordered;
+   /*small representation (NULL once promoted)*/
+   int cap;
+   unsigned char* tags;
+   char* keys;
+   /*large representation (NULL while small)*/
+   hsh_dic* h;
+   rb_dic* t;
+};
+typedef struct _ad_dic ad_dic;
+
+/*Create empty dic, ordered keeps words sorted and promotes to a tree*/
+ad_dic* ad_init(int size, bool ordered);
+
+/* Add one element into the dic */
+void ad_insert(ad_dic* s, char* v);
+
+/* Returns true if v is in the array, false elsewise */
+bool ad_isin(ad_dic* s, char* v);
+
+/* Removes v, returns true if it was in the dic */
+bool ad_remove(ad_dic* s, char* v);
+
+/* Calls f on every word, in sorted order if the dic is ordered */
+void ad_foreach(ad_dic* s, void (*f)(char* v, void* arg), void* arg);
+
+/* Number of words in the dic, O(1) */
+int ad_size(ad_dic* s);
+
+/* Clears all space used, and sets pointer to NULL */
+void ad_free(ad_dic** s);
+
+#endif
@@ -0,0 +1,955 @@
+/***************************************
+ *       ADAPTIVE RADIX TREE (ART)     *
+ *_____________________________________*
+ * - one byte of the word per level,   *
+ *   so lookups cost O(word length)    *
+ *   whatever the dic size             *
+ * - inner nodes grow 4 -> 16 -> 48 -> *
+ *   256 children as they fill, and    *
+ *   shrink back (a little later, so a *
+ *   word added and taken at the edge  *
+ *   doesn't copy nodes each time)     *
+ * - chains of single children fold    *
+ *   into a node prefix (path          *
+ *   compression), shared prefixes of  *
+ *   a word list are stored once       *
+ * - words keep their '\0' so no word  *
+ *   is a prefix of another            *
+ *_____________________________________*
+ ***************************************/
+#include <string.h>
+#include "art.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define IS_LEAF(X) (((uintptr_t) (X)) & 1)
+#define SET_LEAF(X) ((art_node*) (((uintptr_t) (X)) | 1))
+#define LEAF_RAW(X) ((art_leaf*) (((uintptr_t) (X)) & ~(uintptr_t) 1))
+#define MIN(A, B) ((A) < (B) ? (A) : (B))
+/*children left when a node drops to the next size down*/
+#define SHRINK_256 37
+#define SHRINK_48 12
+#define SHRINK_16 3
+
+/*primary*/
+static bool insert_key(art_dic* s, art_node** ref, const unsigned char* key,
+                       uint32_t len, uint32_t depth);
+static art_node** find_child(art_node* n, unsigned char c);
+static void add_child(art_dic* s, art_node* n, art_node** ref,
+                      unsigned char c, art_node* child);
+static art_leaf* remove_key(art_dic* s, art_node** ref,
+                           const unsigned char* key, uint32_t len,
+                           uint32_t depth);
+static void remove_child(art_dic* s, art_node* n, art_node** ref,
+                         unsigned char c, art_node** child);
+static void free_node(art_node* n);
+static void walk_node(art_node* n, void (*f)(char* v, void* arg), void* arg);
+
+/*node growth*/
+static void add_child4(art_dic* s, art_node4* n, art_node** ref,
+                       unsigned char c, art_node* child);
+static void add_child16(art_dic* s, art_node16* n, art_node** ref,
+                        unsigned char c, art_node* child);
+static void add_child48(art_dic* s, art_node48* n, art_node** ref,
+                        unsigned char c, art_node* child);
+static void add_child256(art_node256* n, unsigned char c, art_node* child);
+
+/*node shrinking*/
+static void remove_child4(art_dic* s, art_node4* n, art_node** ref,
+                          art_node** child);
+static void remove_child16(art_dic* s, art_node16* n, art_node** ref,
+                           art_node** child);
+static void remove_child48(art_dic* s, art_node48* n, art_node** ref,
+                           unsigned char c);
+static void remove_child256(art_dic* s, art_node256* n, art_node** ref,
+                            unsigned char c);
+
+/*helper*/
+static art_node* alloc_node(art_dic* s, art_type type);
+static void release_node(art_dic* s, art_node* n);
+static void copy_header(art_node* dest, art_node* src);
+static art_leaf* make_leaf(art_dic* s, const unsigned char* key, uint32_t len);
+static bool leaf_matches(art_leaf* l, const unsigned char* key, uint32_t len);
+static art_leaf* minimum(art_node* n);
+static uint32_t check_prefix(art_node* n, const unsigned char* key,
+                             uint32_t len, uint32_t depth);
+static uint32_t prefix_mismatch(art_node* n, const unsigned char* key,
+                                uint32_t len, uint32_t depth);
+static uint32_t common_prefix(art_leaf* a, art_leaf* b, uint32_t depth);
+static unsigned char* key_of(art_dic* s, char* v, uint32_t* len);
+static size_t node_size(art_type type);
+
+/*Create empty dic*/
+art_dic* art_init(int size)
+{
+   art_dic* dl = (art_dic*) calloc(1, sizeof(art_dic));
+   if (dl == NULL){
+      ON_ERROR("Creation of Dictionary Failed\n");
+   }
+
+   if (size < 2){
+      ON_ERROR("Size must be 2 or greater\n");
+   }
+
+   dl->max_str = size;
+   dl->num_elem = 0;
+   dl->bytes = sizeof(art_dic);
+
+   return dl;
+}
+
+/* Add one element into the dic */
+void art_insert(art_dic* s, char* v)
+{
+   unsigned char* key;
+   uint32_t len;
+
+   if ( v == NULL || s == NULL ){
+      return;
+   }
+
+   if ( strlen(v) < 1 ){
+      return;
+   }
+
+   key = key_of(s, v, &len);
+   if ( insert_key(s, &s->root, key, len, 0) ){
+      s->num_elem++;
+   }
+   if ( key != (unsigned char*) v ){
+      free(key);
+   }
+}
+
+/* Returns true if v is in the array, false elsewise */
+bool art_isin(art_dic* s, char* v)
+{
+   art_node* n;
+   art_node** child;
+   unsigned char* key;
+   uint32_t len, depth = 0;
+   bool isin = false;
+
+   if ( v == NULL || s == NULL ){
+      return false;
+   }
+
+   if ( strlen(v) < 1 ){
+      return false;
+   }
+
+   key = key_of(s, v, &len);
+   n = s->root;
+
+   while ( n != NULL ){
+      if ( IS_LEAF(n) ){
+         isin = leaf_matches(LEAF_RAW(n), key, len);
+         break;
+      }
+
+      /*only the stored part of a long prefix is checked here,
+        the leaf compare at the bottom settles the rest        */
+      if ( n->prefix_len ){
+         if ( check_prefix(n, key, len, depth) != MIN(n->prefix_len, ART_MAX_PREFIX) ){
+            break;
+         }
+         depth += n->prefix_len;
+      }
+
+      if ( depth >= len ){
+         break;
+      }
+
+      child = find_child(n, key[depth]);
+      n = child != NULL ? *child : NULL;
+      depth++;
+   }
+
+   if ( key != (unsigned char*) v ){
+      free(key);
+   }
+   return isin;
+}
+
+/* Removes v, returns true if it was in the dic */
+bool art_remove(art_dic* s, char* v)
+{
+   unsigned char* key;
+   uint32_t len;
+   art_leaf* l;
+
+   if ( v == NULL || s == NULL ){
+      return false;
+   }
+
+   if ( strlen(v) < 1 ){
+      return false;
+   }
+
+   key = key_of(s, v, &len);
+   l = remove_key(s, &s->root, key, len, 0);
+   if ( key != (unsigned char*) v ){
+      free(key);
+   }
+
+   if ( l == NULL ){
+      return false;
+   }
+   s->bytes -= sizeof(art_leaf) + l->len;
+   free(l);
+   s->num_elem--;
+   return true;
+}
+
+/* Calls f on every word in the dic, in sorted order */
+void art_foreach(art_dic* s, void (*f)(char* v, void* arg), void* arg)
+{
+   if ( s == NULL || f == NULL ){
+      return;
+   }
+   walk_node(s->root, f, arg);
+}
+
+/* Number of words in the dic */
+int art_size(art_dic* s)
+{
+   if ( s == NULL ){
+      return 0;
+   }
+   return s->num_elem;
+}
+
+/* Clears all space used, and sets pointer to NULL */
+void art_free(art_dic** s)
+{
+   art_dic* p_d;
+
+   if ( s == NULL ){
+      return;
+   }
+
+   p_d = *s;
+   if ( p_d == NULL ){
+      return;
+   }
+
+   free_node(p_d->root);
+   free(p_d);
+   *s = NULL;
+}
+
+static bool insert_key(art_dic* s, art_node** ref, const unsigned char* key,
+                       uint32_t len, uint32_t depth)
+{
+   /*returns false if the word was already in*/
+   art_node* n = *ref;
+   art_node4* nn;
+   art_node** child;
+   art_leaf* l;
+   art_leaf* l2;
+   uint32_t shared, diff;
+
+   if ( n == NULL ){
+      *ref = SET_LEAF(make_leaf(s, key, len));
+      return true;
+   }
+
+   /*a leaf where the new word goes: split it with a node4 holding
+     the bytes both words share                                    */
+   if ( IS_LEAF(n) ){
+      l = LEAF_RAW(n);
+      if ( leaf_matches(l, key, len) ){
+         return false;
+      }
+
+      l2 = make_leaf(s, key, len);
+      shared = common_prefix(l, l2, depth);
+
+      nn = (art_node4*) alloc_node(s, node4);
+      nn->n.prefix_len = shared;
+      memcpy(nn->n.prefix, key + depth, MIN(ART_MAX_PREFIX, shared));
+      *ref = (art_node*) nn;
+
+      add_child4(s, nn, ref, l->key[depth + shared], n);
+      add_child4(s, nn, ref, l2->key[depth + shared], SET_LEAF(l2));
+      return true;
+   }
+
+   /*the word leaves this node's prefix part way: split the prefix*/
+   if ( n->prefix_len ){
+      diff = prefix_mismatch(n, key, len, depth);
+
+      if ( diff < n->prefix_len ){
+         nn = (art_node4*) alloc_node(s, node4);
+         nn->n.prefix_len = diff;
+         memcpy(nn->n.prefix, n->prefix, MIN(ART_MAX_PREFIX, diff));
+         *ref = (art_node*) nn;
+
+         if ( n->prefix_len <= ART_MAX_PREFIX ){
+            add_child4(s, nn, ref, n->prefix[diff], n);
+            n->prefix_len -= diff + 1;
+            memmove(n->prefix, n->prefix + diff + 1,
+                    MIN(ART_MAX_PREFIX, n->prefix_len));
+         } else {
+            /*prefix bytes past ART_MAX_PREFIX live only in leaves*/
+            n->prefix_len -= diff + 1;
+            l = minimum(n);
+            add_child4(s, nn, ref, l->key[depth + diff], n);
+            memcpy(n->prefix, l->key + depth + diff + 1,
+                   MIN(ART_MAX_PREFIX, n->prefix_len));
+         }
+
+         l = make_leaf(s, key, len);
+         add_child4(s, nn, ref, key[depth + diff], SET_LEAF(l));
+         return true;
+      }
+      depth += n->prefix_len;
+   }
+
+   child = find_child(n, key[depth]);
+   if ( child != NULL ){
+      return insert_key(s, child, key, len, depth + 1);
+   }
+
+   l = make_leaf(s, key, len);
+   add_child(s, n, ref, key[depth], SET_LEAF(l));
+   return true;
+}
+
+static art_leaf* remove_key(art_dic* s, art_node** ref,
+                           const unsigned char* key, uint32_t len,
+                           uint32_t depth)
+{
+   /*unhooks the leaf for key and returns it, NULL if not in. The
+     leaf's parent drops it, shrinking or folding if it must       */
+   art_node* n = *ref;
+   art_node** child;
+   art_leaf* l;
+
+   if ( n == NULL ){
+      return NULL;
+   }
+
+   if ( IS_LEAF(n) ){
+      l = LEAF_RAW(n);
+      if ( !leaf_matches(l, key, len) ){
+         return NULL;
+      }
+      *ref = NULL;
+      return l;
+   }
+
+   if ( n->prefix_len ){
+      if ( check_prefix(n, key, len, depth) != MIN(n->prefix_len, ART_MAX_PREFIX) ){
+         return NULL;
+      }
+      depth += n->prefix_len;
+   }
+
+   if ( depth >= len ){
+      return NULL;
+   }
+
+   child = find_child(n, key[depth]);
+   if ( child == NULL ){
+      return NULL;
+   }
+
+   if ( IS_LEAF(*child) ){
+      l = LEAF_RAW(*child);
+      if ( !leaf_matches(l, key, len) ){
+         return NULL;
+      }
+      remove_child(s, n, ref, key[depth], child);
+      return l;
+   }
+   return remove_key(s, child, key, len, depth + 1);
+}
+
+static art_node** find_child(art_node* n, unsigned char c)
+{
+   art_node4* n4;
+   art_node16* n16;
+   art_node48* n48;
+   art_node256* n256;
+   int i;
+
+   switch (n->type){
+      case node4:
+         n4 = (art_node4*) n;
+         for (i = 0; i < n->num_children; i++){
+            if ( n4->keys[i] == c ){
+               return &n4->children[i];
+            }
+         }
+         break;
+      case node16:
+         n16 = (art_node16*) n;
+#if defined(__SSE2__)
+         {
+            /*all 16 keys against c at once*/
+            __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8((char) c),
+                             _mm_loadu_si128((const __m128i*) n16->keys));
+            unsigned int mask = (unsigned int) _mm_movemask_epi8(cmp) &
+                                ((1u << n->num_children) - 1);
+            if ( mask ){
+               return &n16->children[__builtin_ctz(mask)];
+            }
+         }
+#else
+         for (i = 0; i < n->num_children; i++){
+            if ( n16->keys[i] == c ){
+               return &n16->children[i];
+            }
+         }
+#endif
+         break;
+      case node48:
+         n48 = (art_node48*) n;
+         i = n48->index[c];
+         if ( i ){
+            return &n48->children[i - 1];
+         }
+         break;
+      case node256:
+         n256 = (art_node256*) n;
+         if ( n256->children[c] != NULL ){
+            return &n256->children[c];
+         }
+         break;
+      default:
+         ON_ERROR("\nFind_child() passed an unknown node type");
+   }
+   return NULL;
+}
+
+static void add_child(art_dic* s, art_node* n, art_node** ref,
+                      unsigned char c, art_node* child)
+{
+   switch (n->type){
+      case node4:
+         add_child4(s, (art_node4*) n, ref, c, child);
+         break;
+      case node16:
+         add_child16(s, (art_node16*) n, ref, c, child);
+         break;
+      case node48:
+         add_child48(s, (art_node48*) n, ref, c, child);
+         break;
+      case node256:
+         add_child256((art_node256*) n, c, child);
+         break;
+      default:
+         ON_ERROR("\nAdd_child() passed an unknown node type");
+   }
+}
+
+static void add_child4(art_dic* s, art_node4* n, art_node** ref,
+                       unsigned char c, art_node* child)
+{
+   art_node16* nn;
+   int i;
+
+   if ( n->n.num_children < 4 ){
+      /*keys stay sorted, for in order walks*/
+      for (i = 0; i < n->n.num_children; i++){
+         if ( c < n->keys[i] ){
+            break;
+         }
+      }
+      memmove(n->keys + i + 1, n->keys + i, n->n.num_children - i);
+      memmove(n->children + i + 1, n->children + i,
+              (n->n.num_children - i) * sizeof(art_node*));
+      n->keys[i] = c;
+      n->children[i] = child;
+      n->n.num_children++;
+      return;
+   }
+
+   nn = (art_node16*) alloc_node(s, node16);
+   copy_header(&nn->n, &n->n);
+   memcpy(nn->keys, n->keys, 4);
+   memcpy(nn->children, n->children, 4 * sizeof(art_node*));
+   *ref = (art_node*) nn;
+   release_node(s, &n->n);
+   add_child16(s, nn, ref, c, child);
+}
+
+static void add_child16(art_dic* s, art_node16* n, art_node** ref,
+                        unsigned char c, art_node* child)
+{
+   art_node48* nn;
+   int i;
+
+   if ( n->n.num_children < 16 ){
+      for (i = 0; i < n->n.num_children; i++){
+         if ( c < n->keys[i] ){
+            break;
+         }
+      }
+      memmove(n->keys + i + 1, n->keys + i, n->n.num_children - i);
+      memmove(n->children + i + 1, n->children + i,
+              (n->n.num_children - i) * sizeof(art_node*));
+      n->keys[i] = c;
+      n->children[i] = child;
+      n->n.num_children++;
+      return;
+   }
+
+   nn = (art_node48*) alloc_node(s, node48);
+   copy_header(&nn->n, &n->n);
+   memcpy(nn->children, n->children, 16 * sizeof(art_node*));
+   for (i = 0; i < 16; i++){
+      nn->index[n->keys[i]] = i + 1;
+   }
+   *ref = (art_node*) nn;
+   release_node(s, &n->n);
+   add_child48(s, nn, ref, c, child);
+}
+
+static void add_child48(art_dic* s, art_node48* n, art_node** ref,
+                        unsigned char c, art_node* child)
+{
+   art_node256* nn;
+   int i;
+
+   if ( n->n.num_children < 48 ){
+      for (i = 0; n->children[i] != NULL; i++){
+         ;
+      }
+      n->children[i] = child;
+      n->index[c] = i + 1;
+      n->n.num_children++;
+      return;
+   }
+
+   nn = (art_node256*) alloc_node(s, node256);
+   copy_header(&nn->n, &n->n);
+   for (i = 0; i < 256; i++){
+      if ( n->index[i] ){
+         nn->children[i] = n->children[n->index[i] - 1];
+      }
+   }
+   *ref = (art_node*) nn;
+   release_node(s, &n->n);
+   add_child256(nn, c, child);
+}
+
+static void add_child256(art_node256* n, unsigned char c, art_node* child)
+{
+   n->children[c] = child;
+   n->n.num_children++;
+}
+
+static void remove_child(art_dic* s, art_node* n, art_node** ref,
+                         unsigned char c, art_node** child)
+{
+   switch (n->type){
+      case node4:
+         remove_child4(s, (art_node4*) n, ref, child);
+         break;
+      case node16:
+         remove_child16(s, (art_node16*) n, ref, child);
+         break;
+      case node48:
+         remove_child48(s, (art_node48*) n, ref, c);
+         break;
+      case node256:
+         remove_child256(s, (art_node256*) n, ref, c);
+         break;
+      default:
+         ON_ERROR("\nRemove_child() passed an unknown node type");
+   }
+}
+
+static void remove_child4(art_dic* s, art_node4* n, art_node** ref,
+                          art_node** child)
+{
+   art_node* only;
+   uint32_t prefix, sub;
+   int i = (int) (child - n->children);
+
+   memmove(n->keys + i, n->keys + i + 1, n->n.num_children - 1 - i);
+   memmove(n->children + i, n->children + i + 1,
+           (n->n.num_children - 1 - i) * sizeof(art_node*));
+   n->n.num_children--;
+
+   if ( n->n.num_children > 1 ){
+      return;
+   }
+
+   /*one child left: it takes this node's place. An inner child's
+     prefix becomes this prefix, the key byte, then its own        */
+   only = n->children[0];
+   if ( !IS_LEAF(only) ){
+      prefix = n->n.prefix_len;
+      if ( prefix < ART_MAX_PREFIX ){
+         n->n.prefix[prefix] = n->keys[0];
+         prefix++;
+      }
+      if ( prefix < ART_MAX_PREFIX ){
+         sub = MIN(only->prefix_len, ART_MAX_PREFIX - prefix);
+         memcpy(n->n.prefix + prefix, only->prefix, sub);
+         prefix += sub;
+      }
+      memcpy(only->prefix, n->n.prefix, MIN(prefix, ART_MAX_PREFIX));
+      only->prefix_len += n->n.prefix_len + 1;
+   }
+   *ref = only;
+   release_node(s, &n->n);
+}
+
+static void remove_child16(art_dic* s, art_node16* n, art_node** ref,
+                           art_node** child)
+{
+   art_node4* nn;
+   int i = (int) (child - n->children);
+
+   memmove(n->keys + i, n->keys + i + 1, n->n.num_children - 1 - i);
+   memmove(n->children + i, n->children + i + 1,
+           (n->n.num_children - 1 - i) * sizeof(art_node*));
+   n->n.num_children--;
+
+   if ( n->n.num_children != SHRINK_16 ){
+      return;
+   }
+
+   nn = (art_node4*) alloc_node(s, node4);
+   copy_header(&nn->n, &n->n);
+   memcpy(nn->keys, n->keys, SHRINK_16);
+   memcpy(nn->children, n->children, SHRINK_16 * sizeof(art_node*));
+   *ref = (art_node*) nn;
+   release_node(s, &n->n);
+}
+
+static void remove_child48(art_dic* s, art_node48* n, art_node** ref,
+                           unsigned char c)
+{
+   art_node16* nn;
+   int i, j;
+
+   n->children[n->index[c] - 1] = NULL;
+   n->index[c] = 0;
+   n->n.num_children--;
+
+   if ( n->n.num_children != SHRINK_48 ){
+      return;
+   }
+
+   /*walking the index in byte order keeps the node16 keys sorted*/
+   nn = (art_node16*) alloc_node(s, node16);
+   copy_header(&nn->n, &n->n);
+   for (i = 0, j = 0; i < 256; i++){
+      if ( n->index[i] ){
+         nn->keys[j] = (unsigned char) i;
+         nn->children[j] = n->children[n->index[i] - 1];
+         j++;
+      }
+   }
+   *ref = (art_node*) nn;
+   release_node(s, &n->n);
+}
+
+static void remove_child256(art_dic* s, art_node256* n, art_node** ref,
+                            unsigned char c)
+{
+   art_node48* nn;
+   int i, j;
+
+   n->children[c] = NULL;
+   n->n.num_children--;
+
+   if ( n->n.num_children != SHRINK_256 ){
+      return;
+   }
+
+   nn = (art_node48*) alloc_node(s, node48);
+   copy_header(&nn->n, &n->n);
+   for (i = 0, j = 0; i < 256; i++){
+      if ( n->children[i] != NULL ){
+         nn->children[j] = n->children[i];
+         nn->index[i] = j + 1;
+         j++;
+      }
+   }
+   *ref = (art_node*) nn;
+   release_node(s, &n->n);
+}
+
+static void walk_node(art_node* n, void (*f)(char* v, void* arg), void* arg)
+{
+   /*children in byte order give words in strcmp order*/
+   art_node4* n4;
+   art_node16* n16;
+   art_node48* n48;
+   art_node256* n256;
+   int i;
+
+   if ( n == NULL ){
+      return;
+   }
+
+   if ( IS_LEAF(n) ){
+      f((char*) LEAF_RAW(n)->key, arg);
+      return;
+   }
+
+   switch (n->type){
+      case node4:
+         n4 = (art_node4*) n;
+         for (i = 0; i < n->num_children; i++){
+            walk_node(n4->children[i], f, arg);
+         }
+         break;
+      case node16:
+         n16 = (art_node16*) n;
+         for (i = 0; i < n->num_children; i++){
+            walk_node(n16->children[i], f, arg);
+         }
+         break;
+      case node48:
+         n48 = (art_node48*) n;
+         for (i = 0; i < 256; i++){
+            if ( n48->index[i] ){
+               walk_node(n48->children[n48->index[i] - 1], f, arg);
+            }
+         }
+         break;
+      case node256:
+         n256 = (art_node256*) n;
+         for (i = 0; i < 256; i++){
+            walk_node(n256->children[i], f, arg);
+         }
+         break;
+      default:
+         ON_ERROR("\nWalk_node() passed an unknown node type");
+   }
+}
+
+static void free_node(art_node* n)
+{
+   art_node4* n4;
+   art_node16* n16;
+   art_node48* n48;
+   art_node256* n256;
+   int i;
+
+   if ( n == NULL ){
+      return;
+   }
+
+   if ( IS_LEAF(n) ){
+      free(LEAF_RAW(n));
+      return;
+   }
+
+   switch (n->type){
+      case node4:
+         n4 = (art_node4*) n;
+         for (i = 0; i < n->num_children; i++){
+            free_node(n4->children[i]);
+         }
+         break;
+      case node16:
+         n16 = (art_node16*) n;
+         for (i = 0; i < n->num_children; i++){
+            free_node(n16->children[i]);
+         }
+         break;
+      case node48:
+         n48 = (art_node48*) n;
+         for (i = 0; i < 48; i++){
+            free_node(n48->children[i]);
+         }
+         break;
+      case node256:
+         n256 = (art_node256*) n;
+         for (i = 0; i < 256; i++){
+            free_node(n256->children[i]);
+         }
+         break;
+      default:
+         ON_ERROR("\nFree_node() passed an unknown node type");
+   }
+   free(n);
+}
+
+static art_node* alloc_node(art_dic* s, art_type type)
+{
+   art_node* n = (art_node*) calloc(1, node_size(type));
+
+   if ( n == NULL ){
+      ON_ERROR("\nFailed to make node");
+   }
+
+   n->type = type;
+   s->bytes += node_size(type);
+   return n;
+}
+
+static void release_node(art_dic* s, art_node* n)
+{
+   /*node outgrown or emptied, its children already moved*/
+   s->bytes -= node_size((art_type) n->type);
+   free(n);
+}
+
+static size_t node_size(art_type type)
+{
+   switch (type){
+      case node4:
+         return sizeof(art_node4);
+      case node16:
+         return sizeof(art_node16);
+      case node48:
+         return sizeof(art_node48);
+      case node256:
+         return sizeof(art_node256);
+   }
+   return 0;
+}
+
+static void copy_header(art_node* dest, art_node* src)
+{
+   dest->num_children = src->num_children;
+   dest->prefix_len = src->prefix_len;
+   memcpy(dest->prefix, src->prefix, MIN(ART_MAX_PREFIX, src->prefix_len));
+}
+
+static art_leaf* make_leaf(art_dic* s, const unsigned char* key, uint32_t len)
+{
+   /*exactly the word's bytes, not a max_str buffer*/
+   art_leaf* l = (art_leaf*) malloc(sizeof(art_leaf) + len);
+
+   if ( l == NULL ){
+      ON_ERROR("\nFailed to make leaf");
+   }
+
+   l->len = len;
+   memcpy(l->key, key, len);
+   s->bytes += sizeof(art_leaf) + len;
+   return l;
+}
+
+static bool leaf_matches(art_leaf* l, const unsigned char* key, uint32_t len)
+{
+   if ( l->len != len ){
+      return false;
+   }
+   return memcmp(l->key, key, len) == 0 ? true : false;
+}
+
+static art_leaf* minimum(art_node* n)
+{
+   /*leftmost leaf below n*/
+   art_node48* n48;
+   art_node256* n256;
+   int i;
+
+   while ( n != NULL && !IS_LEAF(n) ){
+      switch (n->type){
+         case node4:
+            n = ((art_node4*) n)->children[0];
+            break;
+         case node16:
+            n = ((art_node16*) n)->children[0];
+            break;
+         case node48:
+            n48 = (art_node48*) n;
+            for (i = 0; !n48->index[i]; i++){
+               ;
+            }
+            n = n48->children[n48->index[i] - 1];
+            break;
+         case node256:
+            n256 = (art_node256*) n;
+            for (i = 0; n256->children[i] == NULL; i++){
+               ;
+            }
+            n = n256->children[i];
+            break;
+         default:
+            ON_ERROR("\nMinimum() passed an unknown node type");
+      }
+   }
+   return n != NULL ? LEAF_RAW(n) : NULL;
+}
+
+static uint32_t check_prefix(art_node* n, const unsigned char* key,
+                             uint32_t len, uint32_t depth)
+{
+   /*matching bytes of the stored prefix*/
+   uint32_t max = MIN(MIN(n->prefix_len, ART_MAX_PREFIX), len - depth);
+   uint32_t i;
+
+   for (i = 0; i < max; i++){
+      if ( n->prefix[i] != key[depth + i] ){
+         return i;
+      }
+   }
+   return i;
+}
+
+static uint32_t prefix_mismatch(art_node* n, const unsigned char* key,
+                                uint32_t len, uint32_t depth)
+{
+   /*like check_prefix, but reads the full prefix from a leaf*/
+   uint32_t max = MIN(MIN(ART_MAX_PREFIX, n->prefix_len), len - depth);
+   uint32_t i;
+   art_leaf* l;
+
+   for (i = 0; i < max; i++){
+      if ( n->prefix[i] != key[depth + i] ){
+         return i;
+      }
+   }
+
+   if ( n->prefix_len > ART_MAX_PREFIX ){
+      l = minimum(n);
+      max = MIN(l->len, len) - depth;
+      for ( ; i < max; i++){
+         if ( l->key[depth + i] != key[depth + i] ){
+            return i;
+         }
+      }
+   }
+   return i;
+}
+
+static uint32_t common_prefix(art_leaf* a, art_leaf* b, uint32_t depth)
+{
+   uint32_t max = MIN(a->len, b->len) - depth;
+   uint32_t i;
+
+   for (i = 0; i < max; i++){
+      if ( a->key[depth + i] != b->key[depth + i] ){
+         return i;
+      }
+   }
+   return i;
+}
+
+static unsigned char* key_of(art_dic* s, char* v, uint32_t* len)
+{
+   /*the word and its '\0', cut to max_str - 1 bytes like the other
+     engines. Only a cut word needs a copy                          */
+   size_t n = strlen(v);
+   unsigned char* key;
+
+   if ( n <= (size_t) s->max_str - 1 ){
+      *len = (uint32_t) n + 1;
+      return (unsigned char*) v;
+   }
+
+   n = s->max_str - 1;
+   key = (unsigned char*) malloc(n + 1);
+   if ( key == NULL ){
+      ON_ERROR("\nKey allocation failed");
+   }
+   memcpy(key, v, n);
+   key[n] = '\0';
+   *len = (uint32_t) n + 1;
+   return key;
+}
@@ -0,0 +1,90 @@
+/**********************************
+ *   Adaptive Radix Tree H file   *
+ *________________________________*
+ * inner nodes hold 4/16/48/256   *
+ * children, single child chains  *
+ * are folded into a prefix       *
+ **********************************/
+#ifndef ART_H
+#define ART_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "dic.h"
+
+#define ART_MAX_PREFIX 10 /*prefix bytes kept in a node, longer
+                            ones are checked against a leaf*/
+
+enum _art_type {node4 = 1, node16, node48, node256};
+typedef enum _art_type art_type;
+
+/*common header of every inner node*/
+typedef struct _art_node {
+   uint8_t type;
+   uint16_t num_children;
+   uint32_t prefix_len;
+   unsigned char prefix[ART_MAX_PREFIX];
+} art_node;
+
+typedef struct _art_node4 {
+   art_node n;
+   unsigned char keys[4];
+   art_node* children[4];
+} art_node4;
+
+typedef struct _art_node16 {
+   art_node n;
+   unsigned char keys[16];
+   art_node* children[16];
+} art_node16;
+
+typedef struct _art_node48 {
+   art_node n;
+   unsigned char index[256]; /*child slot + 1, 0 if none*/
+   art_node* children[48];
+} art_node48;
+
+typedef struct _art_node256 {
+   art_node n;
+   art_node* children[256];
+} art_node256;
+
+/*leaves hold the whole word (with its '\0') and nothing else, so
+  the engine carries no values; child pointers to them carry a set
+  low bit                                                          */
+typedef struct _art_leaf {
+   uint32_t len;
+   unsigned char key[];
+} art_leaf;
+
+struct _art_dic {
+   art_node* root;
+   int max_str;
+   int num_elem;
+   size_t bytes; /*nodes and leaves currently allocated*/
+};
+typedef struct _art_dic art_dic;
+
+/*Create empty dic*/
+art_dic* art_init(int size);
+
+/* Add one element into the dic */
+void art_insert(art_dic* s, char* v);
+
+/* Returns true if v is in the array, false elsewise */
+bool art_isin(art_dic* s, char* v);
+
+/* Removes v, returns true if it was in the dic. Nodes shrink back
+   as they empty and a node left with one child folds into it */
+bool art_remove(art_dic* s, char* v);
+
+/* Calls f on every word in the dic, in sorted order */
+void art_foreach(art_dic* s, void (*f)(char* v, void* arg), void* arg);
+
+/* Number of words in the dic */
+int art_size(art_dic* s);
+
+/* Clears all space used, and sets pointer to NULL */
+void art_free(art_dic** s);
+
+#endif
@@ -0,0 +1,526 @@
+/***************************************
+ *      HOT PATH MICROBENCHMARKS       *
+ *_____________________________________*
+ * - times the inner loops of hsh.c,   *
+ *   redblack.c and bst.c and reads    *
+ *   the CPU's counters around them    *
+ *   with perf_event_open (Linux)      *
+ * - one JSON object per fixture on    *
+ *   stdout, counts per operation, so  *
+ *   runs of two versions can be       *
+ *   diffed                            *
+ * - counters the kernel refuses       *
+ *   (perf_event_paranoid, VMs) come   *
+ *   out as null, timings always work  *
+ *_____________________________________*
+ ***************************************/
+#define _GNU_SOURCE /*syscall()*/
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "dic.h"
+#include "hsh.h"
+#include "redblack.h"
+#include "bst.h"
+
+/*usage: bench [-n words] [-r reps] [-l label]*/
+#define NUM_COUNTERS 6
+#define WORD_LEN 12
+
+/*counter set, one fd per event so a refused one doesn't take the rest*/
+struct _counters {
+   int fd[NUM_COUNTERS];
+   unsigned long long val[NUM_COUNTERS];
+   double secs;
+   struct timespec t0;
+};
+typedef struct _counters counters;
+
+static const char* counter_names[NUM_COUNTERS] = {
+   "cycles", "instructions", "l1d_misses", "llc_misses",
+   "dtlb_misses", "branch_misses"
+};
+
+/*shared by every fixture*/
+struct _bench {
+   char** words;    /*in the dic*/
+   char** misses;   /*never in it*/
+   int n;
+   int reps;
+   const char* label;
+   volatile uint64_t sink; /*keeps results alive past the optimiser*/
+};
+typedef struct _bench bench;
+
+static void counters_open(counters* c);
+static void counters_start(counters* c);
+static void counters_stop(counters* c);
+static void counters_close(counters* c);
+static int open_event(uint32_t type, uint64_t config);
+static void report(bench* b, const char* fixture, counters* c, long ops);
+static char** make_words(int n, uint64_t seed);
+static void free_words(char** w, int n);
+
+/*fixtures*/
+static void fix_hash(bench* b, counters* c);
+static void fix_djb2(bench* b, counters* c);
+static void fix_probe_hit(bench* b, counters* c);
+static void fix_probe_miss(bench* b, counters* c);
+static void fix_insert_growth(bench* b, counters* c);
+static void fix_rehash(bench* b, counters* c);
+static void fix_rb_descent(bench* b, counters* c);
+static void fix_bst_descent(bench* b, counters* c);
+static void fix_rb_free(bench* b, counters* c);
+static void fix_bst_free(bench* b, counters* c);
+
+int main(int argc, char** argv)
+{
+   bench b;
+   counters c;
+   int i;
+
+   memset(&b, 0, sizeof(bench));
+   b.n = 100000;
+   b.reps = 5;
+   b.label = "";
+
+   for (i = 1; i < argc - 1; i++){
+      if ( strcmp(argv[i], "-n") == 0 ){
+         b.n = atoi(argv[++i]);
+      } else if ( strcmp(argv[i], "-r") == 0 ){
+         b.reps = atoi(argv[++i]);
+      } else if ( strcmp(argv[i], "-l") == 0 ){
+         b.label = argv[++i];
+      }
+   }
+   if ( b.n < 1 || b.reps < 1 ){
+      ON_ERROR("Usage: bench [-n words] [-r reps] [-l label]\n");
+   }
+
+   b.words = make_words(b.n, 1);
+   b.misses = make_words(b.n, 2);
+
+   counters_open(&c);
+   fix_hash(&b, &c);
+   fix_djb2(&b, &c);
+   fix_probe_hit(&b, &c);
+   fix_probe_miss(&b, &c);
+   fix_insert_growth(&b, &c);
+   fix_rehash(&b, &c);
+   fix_rb_descent(&b, &c);
+   fix_bst_descent(&b, &c);
+   fix_rb_free(&b, &c);
+   fix_bst_free(&b, &c);
+   counters_close(&c);
+
+   free_words(b.words, b.n);
+   free_words(b.misses, b.n);
+   return 0;
+}
+
+/*the one keyed hash that gives hsh.c its first slot and step*/
+static void fix_hash(bench* b, counters* c)
+{
+   uint64_t seed[2] = {1, 2};
+   uint64_t h = 0;
+   int r, i;
+
+   counters_start(c);
+   for (r = 0; r < b->reps; r++){
+      for (i = 0; i < b->n; i++){
+         h ^= hsh_siphash(b->words[i], WORD_LEN, seed);
+      }
+   }
+   counters_stop(c);
+   b->sink = h;
+   report(b, "hsh_siphash", c, (long) b->reps * b->n);
+}
+
+static void fix_djb2(bench* b, counters* c)
+{
+   uint64_t seed[2] = {1, 2};
+   uint64_t h = 0;
+   int r, i;
+
+   counters_start(c);
+   for (r = 0; r < b->reps; r++){
+      for (i = 0; i < b->n; i++){
+         h ^= hsh_djb2(b->words[i], WORD_LEN, seed);
+      }
+   }
+   counters_stop(c);
+   b->sink = h;
+   report(b, "hsh_djb2", c, (long) b->reps * b->n);
+}
+
+static void fix_probe_hit(bench* b, counters* c)
+{
+   hsh_dic* h = hsh_init(MAXWORD);
+   uint64_t found = 0;
+   int r, i;
+
+   for (i = 0; i < b->n; i++){
+      hsh_insert(h, b->words[i]);
+   }
+
+   counters_start(c);
+   for (r = 0; r < b->reps; r++){
+      for (i = 0; i < b->n; i++){
+         found += hsh_isin(h, b->words[i]);
+      }
+   }
+   counters_stop(c);
+   b->sink = found;
+   report(b, "hsh_probe_hit", c, (long) b->reps * b->n);
+   hsh_free(&h);
+}
+
+static void fix_probe_miss(bench* b, counters* c)
+{
+   hsh_dic* h = hsh_init(MAXWORD);
+   uint64_t found = 0;
+   int r, i;
+
+   for (i = 0; i < b->n; i++){
+      hsh_insert(h, b->words[i]);
+   }
+
+   counters_start(c);
+   for (r = 0; r < b->reps; r++){
+      for (i = 0; i < b->n; i++){
+         found += hsh_isin(h, b->misses[i]);
+      }
+   }
+   counters_stop(c);
+   b->sink = found;
+   report(b, "hsh_probe_miss", c, (long) b->reps * b->n);
+   hsh_free(&h);
+}
+
+/*the same inserts into a table that has to grow and into one
+  presized to never grow, whole loops: growth as inserts see it  */
+static void fix_insert_growth(bench* b, counters* c)
+{
+   counters grow, flat;
+   hsh_dic* h;
+   int r, i, k;
+
+   memset(&grow, 0, sizeof(counters));
+   memset(&flat, 0, sizeof(counters));
+   memcpy(grow.fd, c->fd, sizeof(c->fd));
+   memcpy(flat.fd, c->fd, sizeof(c->fd));
+
+   for (r = 0; r < b->reps; r++){
+      h = hsh_init_len(MAXWORD, 1); /*smallest table, hsh_init's is huge*/
+      counters_start(c);
+      for (i = 0; i < b->n; i++){
+         hsh_insert(h, b->words[i]);
+      }
+      counters_stop(c);
+      for (k = 0; k < NUM_COUNTERS; k++){
+         grow.val[k] += c->val[k];
+      }
+      grow.secs += c->secs;
+      hsh_free(&h);
+
+      h = hsh_init_len(MAXWORD, b->n * 3);
+      counters_start(c);
+      for (i = 0; i < b->n; i++){
+         hsh_insert(h, b->words[i]);
+      }
+      counters_stop(c);
+      for (k = 0; k < NUM_COUNTERS; k++){
+         flat.val[k] += c->val[k];
+      }
+      flat.secs += c->secs;
+      hsh_free(&h);
+   }
+
+   report(b, "hsh_insert_growing", &grow, (long) b->reps * b->n);
+   report(b, "hsh_insert_presized", &flat, (long) b->reps * b->n);
+}
+
+/*only the insert that trips the last resize below n: the table is
+  filled to just under the load factor untimed, then that one insert
+  is timed. The trip point depends only on the count, so an untimed
+  pass finds it. Counts are per resize, of a table of "at" words    */
+static void fix_rehash(bench* b, counters* c)
+{
+   counters all;
+   hsh_dic* h;
+   int r, i, k, resizes, at = -1;
+
+   h = hsh_init_len(MAXWORD, 1);
+   for (i = 0; i < b->n; i++){
+      resizes = h->num_resize;
+      hsh_insert(h, b->words[i]);
+      if ( h->num_resize != resizes ){
+         at = i;
+      }
+   }
+   hsh_free(&h);
+   if ( at < 0 ){
+      return; /*too few words to ever grow*/
+   }
+
+   memset(&all, 0, sizeof(counters));
+   memcpy(all.fd, c->fd, sizeof(c->fd));
+
+   for (r = 0; r < b->reps; r++){
+      h = hsh_init_len(MAXWORD, 1);
+      for (i = 0; i < at; i++){
+         hsh_insert(h, b->words[i]);
+      }
+      resizes = h->num_resize;
+      counters_start(c);
+      hsh_insert(h, b->words[at]);
+      counters_stop(c);
+      if ( h->num_resize == resizes ){
+         ON_ERROR("\nRehash fixture missed the resize");
+      }
+      for (k = 0; k < NUM_COUNTERS; k++){
+         all.val[k] += c->val[k];
+      }
+      all.secs += c->secs;
+      hsh_free(&h);
+   }
+   report(b, "hsh_rehash", &all, b->reps);
+}
+
+static void fix_rb_descent(bench* b, counters* c)
+{
+   rb_dic* t = rb_init(MAXWORD);
+   uint64_t found = 0;
+   int r, i;
+
+   for (i = 0; i < b->n; i++){
+      rb_insert(t, b->words[i]);
+   }
+
+   counters_start(c);
+   for (r = 0; r < b->reps; r++){
+      for (i = 0; i < b->n; i++){
+         found += rb_isin(t, b->words[i]);
+      }
+   }
+   counters_stop(c);
+   b->sink = found;
+   report(b, "rb_descent", c, (long) b->reps * b->n);
+   rb_free(&t);
+}
+
+static void fix_bst_descent(bench* b, counters* c)
+{
+   bst_dic* t = bst_init(MAXWORD);
+   uint64_t found = 0;
+   int r, i;
+
+   for (i = 0; i < b->n; i++){
+      bst_insert(t, b->words[i]);
+   }
+
+   counters_start(c);
+   for (r = 0; r < b->reps; r++){
+      for (i = 0; i < b->n; i++){
+         found += bst_isin(t, b->words[i]);
+      }
+   }
+   counters_stop(c);
+   b->sink = found;
+   report(b, "bst_descent", c, (long) b->reps * b->n);
+   bst_free(&t);
+}
+
+static void fix_rb_free(bench* b, counters* c)
+{
+   counters all;
+   rb_dic* t;
+   int r, i, k;
+
+   memset(&all, 0, sizeof(counters));
+   memcpy(all.fd, c->fd, sizeof(c->fd));
+
+   for (r = 0; r < b->reps; r++){
+      t = rb_init(MAXWORD);
+      for (i = 0; i < b->n; i++){
+         rb_insert(t, b->words[i]);
+      }
+      counters_start(c);
+      rb_free(&t);
+      counters_stop(c);
+      for (k = 0; k < NUM_COUNTERS; k++){
+         all.val[k] += c->val[k];
+      }
+      all.secs += c->secs;
+   }
+   report(b, "rb_free_tree", &all, (long) b->reps * b->n);
+}
+
+static void fix_bst_free(bench* b, counters* c)
+{
+   counters all;
+   bst_dic* t;
+   int r, i, k;
+
+   memset(&all, 0, sizeof(counters));
+   memcpy(all.fd, c->fd, sizeof(c->fd));
+
+   for (r = 0; r < b->reps; r++){
+      t = bst_init(MAXWORD);
+      for (i = 0; i < b->n; i++){
+         bst_insert(t, b->words[i]);
+      }
+      counters_start(c);
+      bst_free(&t);
+      counters_stop(c);
+      for (k = 0; k < NUM_COUNTERS; k++){
+         all.val[k] += c->val[k];
+      }
+      all.secs += c->secs;
+   }
+   report(b, "bst_free_tree", &all, (long) b->reps * b->n);
+}
+
+static void counters_open(counters* c)
+{
+   const uint64_t rd_miss = PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                            PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+
+   memset(c, 0, sizeof(counters));
+   c->fd[0] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+   c->fd[1] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+   c->fd[2] = open_event(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | rd_miss);
+   c->fd[3] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+   c->fd[4] = open_event(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | rd_miss);
+   c->fd[5] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+}
+
+static int open_event(uint32_t type, uint64_t config)
+{
+   /*user space only, this thread, on any cpu; -1 if refused*/
+   struct perf_event_attr attr;
+
+   memset(&attr, 0, sizeof(attr));
+   attr.size = sizeof(attr);
+   attr.type = type;
+   attr.config = config;
+   attr.disabled = 1;
+   attr.exclude_kernel = 1;
+   attr.exclude_hv = 1;
+   attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                      PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+   return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void counters_start(counters* c)
+{
+   int k;
+
+   for (k = 0; k < NUM_COUNTERS; k++){
+      if ( c->fd[k] >= 0 ){
+         ioctl(c->fd[k], PERF_EVENT_IOC_RESET, 0);
+         ioctl(c->fd[k], PERF_EVENT_IOC_ENABLE, 0);
+      }
+   }
+   clock_gettime(CLOCK_MONOTONIC, &c->t0);
+}
+
+static void counters_stop(counters* c)
+{
+   /*scaled up when the kernel multiplexed a counter*/
+   struct timespec t1;
+   uint64_t buf[3];
+   int k;
+
+   clock_gettime(CLOCK_MONOTONIC, &t1);
+   c->secs = (t1.tv_sec - c->t0.tv_sec) + (t1.tv_nsec - c->t0.tv_nsec) / 1e9;
+
+   for (k = 0; k < NUM_COUNTERS; k++){
+      c->val[k] = 0;
+      if ( c->fd[k] < 0 ){
+         continue;
+      }
+      ioctl(c->fd[k], PERF_EVENT_IOC_DISABLE, 0);
+      if ( read(c->fd[k], buf, sizeof(buf)) != (ssize_t) sizeof(buf) ){
+         continue;
+      }
+      if ( buf[2] > 0 && buf[2] < buf[1] ){
+         buf[0] = (uint64_t) ((double) buf[0] * buf[1] / buf[2]);
+      }
+      c->val[k] = buf[0];
+   }
+}
+
+static void counters_close(counters* c)
+{
+   int k;
+
+   for (k = 0; k < NUM_COUNTERS; k++){
+      if ( c->fd[k] >= 0 ){
+         close(c->fd[k]);
+      }
+   }
+}
+
+static void report(bench* b, const char* fixture, counters* c, long ops)
+{
+   int k;
+
+   printf("{\"label\":\"%s\",\"fixture\":\"%s\",\"words\":%d,\"ops\":%ld,"
+          "\"ns_per_op\":%.3f", b->label, fixture, b->n, ops,
+          c->secs * 1e9 / ops);
+   for (k = 0; k < NUM_COUNTERS; k++){
+      if ( c->fd[k] < 0 ){
+         printf(",\"%s\":null", counter_names[k]);
+      } else {
+         printf(",\"%s\":%.3f", counter_names[k], (double) c->val[k] / ops);
+      }
+   }
+   printf("}\n");
+   fflush(stdout);
+}
+
+static char** make_words(int n, uint64_t seed)
+{
+   /*fixed length lowercase words from xorshift, same every run*/
+   char** w = (char**) malloc(n * sizeof(char*));
+   uint64_t x = seed * 0x9e3779b97f4a7c15ULL;
+   int i, j;
+
+   if ( w == NULL ){
+      ON_ERROR("\nBench word allocation failed");
+   }
+
+   for (i = 0; i < n; i++){
+      w[i] = (char*) malloc(WORD_LEN + 1);
+      if ( w[i] == NULL ){
+         ON_ERROR("\nBench word allocation failed");
+      }
+      for (j = 0; j < WORD_LEN; j++){
+         x ^= x << 13;
+         x ^= x >> 7;
+         x ^= x << 17;
+         w[i][j] = 'a' + (char) (x % 26);
+      }
+      w[i][WORD_LEN] = '\0';
+      /*misses differ from every word in the first byte*/
+      if ( seed == 2 ){
+         w[i][0] = 'A' + (char) (x % 26);
+      }
+   }
+   return w;
+}
+
+static void free_words(char** w, int n)
+{
+   int i;
+
+   for (i = 0; i < n; i++){
+      free(w[i]);
+   }
+   free(w);
+}
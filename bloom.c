@@ -0,0 +1,164 @@
+/***************************************
+ *        BLOCKED BLOOM FILTER         *
+ *_____________________________________*
+ * - one keyed hash per word picks a   *
+ *   512 bit block, the k bits are all *
+ *   set inside it; blocks are cache   *
+ *   line aligned, so a check touches  *
+ *   exactly one line                  *
+ * - sized from the expected count:    *
+ *     bits = -n ln(p) / ln(2)^2       *
+ *     k    = bits / n * ln(2)         *
+ * - words can't be taken back out, a  *
+ *   removed word only costs a false   *
+ *   positive                          *
+ *_____________________________________*
+ ***************************************/
+#include <string.h>
+#include <math.h>
+#include "bloom.h"
+#include "hsh.h"
+
+#define LN2 0.69314718055994530942
+#define BLOCK_WORDS BLOOM_BLOCK_WORDS
+#define BLOCK_BITS (BLOCK_WORDS * 64)
+#define MAX_K 16
+#define BLOCK_SLACK 1.2 /*blocks fill unevenly, extra bits keep fp_rate*/
+#define GOLDEN 0x9e3779b97f4a7c15ULL
+
+static uint64_t* block_of(bloom* b, uint64_t h);
+
+/*Create a filter sized for expected words at false positive rate fp_rate*/
+bloom* bloom_init(long expected, double fp_rate)
+{
+   bloom* b = NULL;
+   double bits;
+
+   if (expected < 1){
+      expected = 1;
+   }
+
+   if (fp_rate <= 0 || fp_rate >= 1){
+      ON_ERROR("Bloom false positive rate must be between 0 and 1\n");
+   }
+
+   b = (bloom*) calloc(1, sizeof(bloom));
+   if (b == NULL){
+      ON_ERROR("Creation of Bloom Filter Failed\n");
+   }
+
+   bits = -(double) expected * log(fp_rate) / (LN2 * LN2);
+   b->num_blocks = (unsigned long) ceil(bits * BLOCK_SLACK / BLOCK_BITS);
+   if (b->num_blocks < 1){
+      b->num_blocks = 1;
+   }
+
+   b->k = (int) (bits / expected * LN2 + 0.5);
+   if (b->k < 1){
+      b->k = 1;
+   }
+   if (b->k > MAX_K){
+      b->k = MAX_K;
+   }
+
+   /*calloc only promises 16 byte alignment: take a line extra and
+     start the bits at the first line boundary inside              */
+   b->bits_raw = calloc(1, b->num_blocks * BLOCK_WORDS * sizeof(uint64_t) +
+                        BLOOM_ALIGN - 1);
+   if (b->bits_raw == NULL){
+      ON_ERROR("Creation of Bloom Bit Array Failed\n");
+   }
+   b->bits = (uint64_t*) (((uintptr_t) b->bits_raw + BLOOM_ALIGN - 1) &
+                          ~(uintptr_t) (BLOOM_ALIGN - 1));
+
+   hsh_random_seed(b->seed);
+
+   return b;
+}
+
+/* Adds the first len bytes of v */
+void bloom_add(bloom* b, const char* v, size_t len)
+{
+   uint64_t h;
+   uint64_t* block;
+   uint32_t h1, h2, bit;
+   int i;
+
+   if ( b == NULL || v == NULL ){
+      return;
+   }
+
+   h = hsh_siphash(v, len, b->seed);
+   block = block_of(b, h);
+   h1 = (uint32_t) h;
+   h2 = (uint32_t) ((h * GOLDEN) >> 32) | 1;
+
+   for (i = 0; i < b->k; i++){
+      bit = (h1 + i * h2) % BLOCK_BITS;
+      block[bit / 64] |= (uint64_t) 1 << (bit % 64);
+   }
+}
+
+/* False if v was never added, true if it may have been */
+bool bloom_maybe(bloom* b, const char* v, size_t len)
+{
+   uint64_t h;
+   uint64_t* block;
+   uint32_t h1, h2, bit;
+   int i;
+
+   if ( b == NULL || v == NULL ){
+      return true;
+   }
+
+   b->num_checks++;
+
+   h = hsh_siphash(v, len, b->seed);
+   block = block_of(b, h);
+   h1 = (uint32_t) h;
+   h2 = (uint32_t) ((h * GOLDEN) >> 32) | 1;
+
+   for (i = 0; i < b->k; i++){
+      bit = (h1 + i * h2) % BLOCK_BITS;
+      if ( !(block[bit / 64] & ((uint64_t) 1 << (bit % 64))) ){
+         b->num_rejects++;
+         return false;
+      }
+   }
+   return true;
+}
+
+/* Bytes used by the bit array */
+size_t bloom_bytes(bloom* b)
+{
+   if ( b == NULL ){
+      return 0;
+   }
+   return (size_t) b->num_blocks * BLOCK_WORDS * sizeof(uint64_t);
+}
+
+/* Clears all space used, and sets pointer to NULL */
+void bloom_free(bloom** b)
+{
+   bloom* p_b;
+
+   if ( b == NULL ){
+      return;
+   }
+
+   p_b = *b;
+   if ( p_b == NULL ){
+      return;
+   }
+
+   free(p_b->bits_raw);
+   free(p_b);
+   *b = NULL;
+}
+
+static uint64_t* block_of(bloom* b, uint64_t h)
+{
+   /*high half picks the block, without a divide*/
+   uint64_t i = ((h >> 32) * (uint64_t) b->num_blocks) >> 32;
+   return b->bits + i * BLOCK_WORDS;
+}
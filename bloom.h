@@ -0,0 +1,46 @@
+/**********************************
+ *     Blocked Bloom Filter H     *
+ *________________________________*
+ * approximate membership kept in *
+ * front of a dic: "no" is always *
+ * right, "maybe" is wrong at     *
+ * about fp_rate                  *
+ **********************************/
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "dic.h"
+
+#define BLOOM_BLOCK_WORDS 8 /*512 bit blocks, one cache line*/
+#define BLOOM_ALIGN 64      /*so each block is exactly one line*/
+
+struct _bloom {
+   uint64_t* bits;      /*BLOOM_ALIGN aligned, inside bits_raw*/
+   void* bits_raw;      /*what calloc gave, for free*/
+   unsigned long num_blocks;
+   int k;               /*bits set per word*/
+   uint64_t seed[2];
+   /*how often it saved a lookup*/
+   unsigned long num_checks;
+   unsigned long num_rejects;
+};
+typedef struct _bloom bloom;
+
+/*Create a filter sized for expected words at false positive rate fp_rate*/
+bloom* bloom_init(long expected, double fp_rate);
+
+/* Adds the first len bytes of v */
+void bloom_add(bloom* b, const char* v, size_t len);
+
+/* False if v was never added, true if it may have been */
+bool bloom_maybe(bloom* b, const char* v, size_t len);
+
+/* Bytes used by the bit array */
+size_t bloom_bytes(bloom* b);
+
+/* Clears all space used, and sets pointer to NULL */
+void bloom_free(bloom** b);
+
+#endif
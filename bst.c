@@ -5,10 +5,16 @@
  * based on Red-Black properties       *
  * - slower initial set-up but faster  *
  *   searching afterwards              *
+ * - bst_init_mode adds treap or splay *
+ *   balancing, no colours or parents  *
  *_____________________________________*
  ***************************************/
 
 #include <assert.h>
+#include "bst.h"
+#include "hot.h"
+#include "prefix.h"
+#include "hsh.h"
 
 #define RED_AUNT a != NULL && a->color == red
 #define IS_ROOT n->parent == NULL
@@ -19,24 +25,40 @@
 #define LEFT_RIGHT p == gl && n == p->right
 
 /*primary*/
-void insert_node( Node* r, Node* n);
-Node* create_node( dic* s);
-void set_node_value( Node* n, char* v);
-void isin_tree( Node* n, char* v, bool* isin);
-void free_tree( Node* n); 
+static bool insert_node( bst_node* r, bst_node* n);
+static bst_node* create_node( bst_dic* s);
+static void set_node_value( bst_node* n, char* v);
+static void isin_tree( bst_node* n, char* v, uint64_t pv, bool* isin);
+static void free_tree( bst_node* n); 
+static void walk_tree( bst_node* n, void (*f)(char* v, void* arg), void* arg);
+
+/*balancing modes*/
+static bst_node* treap_insert(bst_dic* s, bst_node* t, bst_node* n,
+                              bool* added);
+static bst_node* splay(bst_dic* s, bst_node* t, char* v);
+static bool splay_insert(bst_dic* s, bst_node* n);
+static bst_node* find_node(bst_node* n, char* v);
+static uint32_t next_prio(bst_dic* s);
 
 /*helper*/
-void set_new_root(dic* s, Node* n); 
-void go_left(Node* r, Node* n);
-void go_right(Node* r, Node* n);
-void check_left(Node* n, char* v, bool* isin);
-void check_right(Node* n, char* v, bool* isin);
-void print_tree( Node* n);
+static void set_new_root(bst_dic* s, bst_node* n); 
+static bool go_left(bst_node* r, bst_node* n);
+static bool go_right(bst_node* r, bst_node* n);
+static void check_left(bst_node* n, char* v, uint64_t pv, bool* isin);
+static void check_right(bst_node* n, char* v, uint64_t pv, bool* isin);
+
+/*stats walk*/
+typedef struct _bst_walk {
+   bst_node* n;
+   int depth;
+} bst_walk;
+static bst_walk* push_walk(bst_walk* stack, int* top, int* cap, bst_node* n,
+                           int depth);
 
 /*Create empty dic*/
-dic* dic_init(int size) 
+bst_dic* bst_init(int size) 
 {
-   dic* dl = (dic*) calloc(1,sizeof(dic));
+   bst_dic* dl = (bst_dic*) calloc(1,sizeof(bst_dic));
    if(dl == NULL){
       ON_ERROR("Creation of Dictionary Failed\n");
    }
@@ -47,14 +69,32 @@ dic* dic_init(int size)
 
    dl->max_str = size;
    dl->num_nodes = 0; 
+   dl->mode = bst_plain;
 
    return dl; 
 }
 
+/*Create empty dic that keeps itself balanced with mode.
+  Splay mode changes the tree on lookups too, so it is
+  not safe to read from several threads                */
+bst_dic* bst_init_mode(int size, bst_mode mode)
+{
+   bst_dic* dl = bst_init(size);
+   uint64_t seed[2];
+
+   dl->mode = mode;
+   if ( mode == bst_treap ){
+      hsh_random_seed(seed);
+      dl->rng = seed[0] | 1;
+   }
+
+   return dl;
+}
+
 /* Add one element into the dic */
-void dic_insert(dic* s, char* v)
+void bst_insert(bst_dic* s, char* v)
 { 
-   Node* n;
+   bst_node* n;
 
    if ( v == NULL || s == NULL ){
       ON_ERROR("\nDic_insert() passed a NULL value"); 
@@ -70,19 +110,45 @@ void dic_insert(dic* s, char* v)
 
    if ( s->root == NULL ){
       set_new_root(s, n); 
+      s->num_nodes++;
       return;  
    }
 
-   insert_node(s->root, n);
+   if ( s->mode == bst_treap ){
+      bool added = false;
+      s->root = treap_insert(s, s->root, n, &added);
+      if ( added ){
+         s->num_nodes++;
+      } else {
+         free(n->pstr);
+         free(n);
+      }
+      return;
+   }
+
+   if ( s->mode == bst_splay ){
+      if ( splay_insert(s, n) ){
+         s->num_nodes++;
+      } else {
+         free(n->pstr);
+         free(n);
+      }
+      return;
+   }
+
+   /*duplicates are freed by insert_node*/
+   if ( insert_node(s->root, n) ){
+      s->num_nodes++;
+   }
 }
 
-void set_new_root(dic* s, Node* n)
+static void set_new_root(bst_dic* s, bst_node* n)
 {
    s->root = n;
 }
 
 /* Returns true if v is in the array, false elsewise */
-bool dic_isin(dic* s, char* v)
+bool bst_isin(bst_dic* s, char* v)
 {
    bool isin = false;
 
@@ -94,18 +160,169 @@ bool dic_isin(dic* s, char* v)
       return false; 
    }
 
-   isin_tree(s->root, v, &isin);
+   if ( s->hot != NULL && hot_find(s->hot, v) ){
+      return true;
+   }
+
+   if ( s->mode == bst_splay ){
+      s->root = splay(s, s->root, v);
+      isin = s->root != NULL && key_compare(v, key_prefix(v), s->root->pstr,
+                                            s->root->prefix) == 0 ? true : false;
+   } else if ( s->mode == bst_treap ){
+      isin = find_node(s->root, v) != NULL ? true : false;
+   } else {
+      isin_tree(s->root, v, key_prefix(v), &isin);
+   }
 
    if ( isin ){
+      hot_add(s->hot, v);
       return true; 
    }
    return false; 
 }
 
+/* Puts a cache of about entries recently found words in front of
+   bst_isin, 0 removes it. Lookups then write the cache, so a cached
+   dic must be read from one thread only */
+void bst_hot_cache(bst_dic* s, int entries)
+{
+   if ( s == NULL ){
+      return;
+   }
+
+   hot_free(&s->hot);
+   if ( entries > 0 ){
+      s->hot = hot_init(entries, s->max_str);
+   }
+}
+
+/* Calls f on every word in the dic, in sorted order */
+void bst_foreach(bst_dic* s, void (*f)(char* v, void* arg), void* arg)
+{
+   if ( s == NULL || f == NULL ){
+      return; 
+   }
+   walk_tree(s->root, f, arg);
+}
+
+static void walk_tree(bst_node* n, void (*f)(char* v, void* arg), void* arg)
+{
+   /*explicit stack: a splayed (or plain, sorted) tree can be a list*/
+   bst_walk* stack = NULL;
+   int top = 0, cap = 0;
+
+   while ( n != NULL || top > 0 ){
+      while ( n != NULL ){
+         stack = push_walk(stack, &top, &cap, n, 0);
+         n = n->left;
+      }
+      n = stack[--top].n;
+      f(n->pstr, arg);
+      n = n->right;
+   }
+   free(stack);
+}
+
+/* Number of words in the dic */
+int bst_size(bst_dic* s)
+{
+   if ( s == NULL ){
+      return 0; 
+   }
+   return s->num_nodes; 
+}
+
+/* Fills st with the shape of s: height, depths, bytes */
+void bst_get_stats(bst_dic* s, bst_stats* st)
+{
+   /*iterative walk so a list shaped tree can't blow the stack*/
+   bst_walk* stack = NULL;
+   int top = 0, cap = 0, depth;
+   double depth_total = 0;
+   bst_node* n;
+
+   if ( s == NULL || st == NULL ){
+      ON_ERROR("\nBst_get_stats() passed a NULL value");
+   }
+
+   memset(st, 0, sizeof(bst_stats));
+   st->num_nodes = s->num_nodes;
+   st->num_rotate = s->num_rotate;
+   st->bytes = sizeof(bst_dic) + 
+               (size_t) s->num_nodes * (sizeof(bst_node) + s->max_str);
+   if ( s->hot != NULL ){
+      st->hot_lookups = s->hot->num_lookups;
+      st->hot_hits = s->hot->num_hits;
+      st->bytes += sizeof(hot_cache) + (size_t) s->hot->num_sets *
+                   (sizeof(hot_set) + HOT_WAYS * s->max_str);
+   }
+
+   if ( s->root == NULL ){
+      return; 
+   }
+
+   stack = push_walk(stack, &top, &cap, s->root, 1);
+
+   while ( top > 0 ){
+      top--;
+      n = stack[top].n;
+      depth = stack[top].depth;
+
+      depth_total += depth;
+      if ( depth > st->height ){
+         st->height = depth; 
+      }
+
+      if ( n->left != NULL ){
+         stack = push_walk(stack, &top, &cap, n->left, depth + 1);
+      }
+      if ( n->right != NULL ){
+         stack = push_walk(stack, &top, &cap, n->right, depth + 1);
+      }
+   }
+
+   st->avg_depth = depth_total / s->num_nodes;
+   free(stack);
+}
+
+/* Prints the stats from bst_get_stats */
+void bst_print_stats(bst_stats* st)
+{
+   if ( st == NULL ){
+      return; 
+   }
+
+   printf("\nnodes %d, height %d, avg depth %.2f, bytes %lu\n",
+          st->num_nodes, st->height, st->avg_depth, (unsigned long) st->bytes);
+   if ( st->num_rotate > 0 ){
+      printf("rotations %lu\n", st->num_rotate);
+   }
+   if ( st->hot_lookups > 0 ){
+      printf("hot cache hits %lu of %lu (%.1f%%)\n", st->hot_hits,
+             st->hot_lookups, 100.0 * st->hot_hits / st->hot_lookups);
+   }
+}
+
+static bst_walk* push_walk(bst_walk* stack, int* top, int* cap, bst_node* n,
+                           int depth)
+{
+   if ( *top == *cap ){
+      *cap = *cap ? *cap * 2 : 64;
+      stack = (bst_walk*) realloc(stack, sizeof(bst_walk) * *cap);
+      if ( stack == NULL ){
+         ON_ERROR("\nWalk stack allocation failed");
+      }
+   }
+   stack[*top].n = n;
+   stack[*top].depth = depth;
+   (*top)++;
+   return stack;
+}
+
 /* Clears all space used, and sets pointer to NULL */
-void dic_free(dic** s)
+void bst_free(bst_dic** s)
 {
-   dic* p_d;
+   bst_dic* p_d;
 
    if ( s == NULL ){
       return; 
@@ -117,34 +334,35 @@ void dic_free(dic** s)
    }
 
    free_tree(p_d->root); 
+   hot_free(&p_d->hot);
 
    free(p_d);    
-   p_d = NULL;
+   *s = NULL;
 }
 
-void free_tree(Node* n)
+static void free_tree(bst_node* n)
 {
-   if (n == NULL){
-      return; 
-   }
-
-   /*free string on n*/
-   if (n->pstr != NULL){
+   /*rotates left children up until there are none, then frees
+     along the right spine: no recursion, no stack              */
+   bst_node* l;
+   bst_node* next;
+
+   while ( n != NULL ){
+      if ( n->left != NULL ){
+         l = n->left;
+         n->left = l->right;
+         l->right = n;
+         n = l;
+         continue;
+      }
+      next = n->right;
       free(n->pstr);
+      free(n);
+      n = next;
    }
-
-   /*go left and right*/
-   if (n->left != NULL){
-      free_tree(n->left);
-   } 
-   if (n->right != NULL){
-      free_tree(n->right);
-   }
-
-   free(n);
 }
 
-void isin_tree(Node* n, char* v, bool* isin)
+static void isin_tree(bst_node* n, char* v, uint64_t pv, bool* isin)
 {
    /*recursively search tree*/
    int compare; 
@@ -154,7 +372,7 @@ void isin_tree(Node* n, char* v, bool* isin)
       return;
    }
 
-   compare = strcmp(v, n->pstr);
+   compare = key_compare(v, pv, n->pstr, n->prefix);
 
    if ( compare == 0 ) {
       *isin = true;
@@ -163,39 +381,39 @@ void isin_tree(Node* n, char* v, bool* isin)
 
    if ( compare < 0 ){  
  
-      check_left(n, v, isin); 
+      check_left(n, v, pv, isin); 
 
    } else {              
 
-      check_right(n, v, isin); 
+      check_right(n, v, pv, isin); 
 
    }
    return; 
 }
 
-void check_left(Node* n, char* v, bool* isin)
+static void check_left(bst_node* n, char* v, uint64_t pv, bool* isin)
 {
    if (n->left == NULL){
       *isin = false;
       return; 
    } else {
-      isin_tree(n->left, v, isin);
+      isin_tree(n->left, v, pv, isin);
    }
 }
 
-void check_right(Node* n, char* v, bool* isin)
+static void check_right(bst_node* n, char* v, uint64_t pv, bool* isin)
 {
    if (n->right == NULL){
       *isin = false;
       return; 
    } else {
-      isin_tree(n->right, v, isin); 
+      isin_tree(n->right, v, pv, isin); 
    }
 }
 
-Node* create_node(dic* s)
+static bst_node* create_node(bst_dic* s)
 {
-   Node* n = (Node*) calloc(1, sizeof(Node));
+   bst_node* n = (bst_node*) calloc(1, sizeof(bst_node));
 
    if ( n == NULL ){
       ON_ERROR("\nFailed to make node"); 
@@ -204,11 +422,16 @@ Node* create_node(dic* s)
    n->left  = NULL;
    n->right = NULL; 
    n->max_str = s->max_str;
+   if ( s->mode == bst_treap ){
+      /*every node draws one, the first root included, so the
+        priorities stay independent and uniform              */
+      n->prio = next_prio(s);
+   }
 
    return n; 
 }
 
-void set_node_value(Node* n, char* v)
+static void set_node_value(bst_node* n, char* v)
 {
    /*get space for word and point pstr to space*/
    n->pstr = (char*) calloc(n->max_str, sizeof(char));
@@ -218,63 +441,223 @@ void set_node_value(Node* n, char* v)
    }  
 
    strncpy(n->pstr, v, strlen(v));
+   n->prefix = key_prefix(n->pstr);
 }
 
-void insert_node(Node* r, Node* n)
+static bool insert_node(bst_node* r, bst_node* n)
 {
-   /* recursively find correct location and add node there */
+   /* recursively find correct location and add node there,
+      returns false (and frees n) if the word is already in */
    int compare; 
 
-   if ( r == NULL ) {return;}
+   if ( r == NULL ) {return false;}
 
-   compare = strcmp(n->pstr, r->pstr);
+   compare = key_compare(n->pstr, n->prefix, r->pstr, r->prefix);
    if ( compare == 0 ){    /*don't add duplicates*/
       if (n != NULL) {
          free(n->pstr);
          free(n); 
       }
-      return; 
+      return false; 
    }
 
    if ( compare < 0 ){
 
-      go_left(r, n); 
+      return go_left(r, n); 
 
    } else { 
 
-     go_right(r, n);              
+     return go_right(r, n);              
 
    }
 } 
 
-void go_left(Node* r, Node* n)
+static bool go_left(bst_node* r, bst_node* n)
 {
    if (r->left == NULL){
       /*add node to r left*/
       r->left = n;
-   } else {
-      insert_node(r->left, n);
-   }
+      return true;
+   } 
+   return insert_node(r->left, n);
 }
 
-void go_right(Node* r, Node* n)
+static bool go_right(bst_node* r, bst_node* n)
 {
    if (r->right == NULL){
       /*add node to r right*/
       r->right = n;
+      return true;
+   } 
+   return insert_node(r->right, n); 
+}
+
+static bst_node* treap_insert(bst_dic* s, bst_node* t, bst_node* n,
+                              bool* added)
+{
+   /*plain insert, then rotate n up while its priority beats its
+     parent's. Returns the new root of t; recursion is O(log n)
+     deep on average whatever the input order                   */
+   bst_node* c;
+   int compare;
+
+   if ( t == NULL ){
+      *added = true;
+      return n;
+   }
+
+   compare = key_compare(n->pstr, n->prefix, t->pstr, t->prefix);
+   if ( compare == 0 ){
+      *added = false;
+      return t;
+   }
+
+   if ( compare < 0 ){
+      t->left = treap_insert(s, t->left, n, added);
+      if ( t->left->prio > t->prio ){
+         c = t->left;
+         t->left = c->right;
+         c->right = t;
+         s->num_rotate++;
+         return c;
+      }
+   } else {
+      t->right = treap_insert(s, t->right, n, added);
+      if ( t->right->prio > t->prio ){
+         c = t->right;
+         t->right = c->left;
+         c->left = t;
+         s->num_rotate++;
+         return c;
+      }
+   }
+   return t;
+}
+
+static bst_node* splay(bst_dic* s, bst_node* t, char* v)
+{
+   /*top down splay (Sleator and Tarjan): brings v, or the last node
+     on its search path, to the root in one pass. Left and right
+     trees are built hanging off the dummy node                    */
+   bst_node dummy;
+   bst_node* l;
+   bst_node* r;
+   bst_node* y;
+   uint64_t pv = key_prefix(v);
+   int compare;
+
+   if ( t == NULL ){
+      return NULL;
+   }
+
+   dummy.left = dummy.right = NULL;
+   l = r = &dummy;
+
+   for (;;){
+      compare = key_compare(v, pv, t->pstr, t->prefix);
+      if ( compare < 0 ){
+         if ( t->left == NULL ){
+            break;
+         }
+         if ( key_compare(v, pv, t->left->pstr, t->left->prefix) < 0 ){
+            y = t->left;       /*zig zig: rotate right first*/
+            t->left = y->right;
+            y->right = t;
+            t = y;
+            s->num_rotate++;
+            if ( t->left == NULL ){
+               break;
+            }
+         }
+         r->left = t;          /*link right*/
+         r = t;
+         t = t->left;
+      } else if ( compare > 0 ){
+         if ( t->right == NULL ){
+            break;
+         }
+         if ( key_compare(v, pv, t->right->pstr, t->right->prefix) > 0 ){
+            y = t->right;      /*zag zag: rotate left first*/
+            t->right = y->left;
+            y->left = t;
+            t = y;
+            s->num_rotate++;
+            if ( t->right == NULL ){
+               break;
+            }
+         }
+         l->right = t;         /*link left*/
+         l = t;
+         t = t->right;
+      } else {
+         break;
+      }
+   }
+
+   /*reassemble*/
+   l->right = t->left;
+   r->left = t->right;
+   t->left = dummy.right;
+   t->right = dummy.left;
+   return t;
+}
+
+static bool splay_insert(bst_dic* s, bst_node* n)
+{
+   /*splay the neighbour of n to the root, then n goes above it*/
+   bst_node* t = splay(s, s->root, n->pstr);
+   int compare = key_compare(n->pstr, n->prefix, t->pstr, t->prefix);
+
+   if ( compare == 0 ){
+      s->root = t;
+      return false;
+   }
+
+   if ( compare < 0 ){
+      n->left = t->left;
+      n->right = t;
+      t->left = NULL;
    } else {
-      insert_node(r->right, n); 
+      n->right = t->right;
+      n->left = t;
+      t->right = NULL;
+   }
+   s->root = n;
+   return true;
+}
+
+static bst_node* find_node(bst_node* n, char* v)
+{
+   uint64_t pv = key_prefix(v);
+   int compare;
+
+   while ( n != NULL ){
+      compare = key_compare(v, pv, n->pstr, n->prefix);
+      if ( compare == 0 ){
+         return n;
+      }
+      n = compare < 0 ? n->left : n->right;
    }
+   return NULL;
+}
+
+static uint32_t next_prio(bst_dic* s)
+{
+   /*xorshift64*/
+   s->rng ^= s->rng << 13;
+   s->rng ^= s->rng >> 7;
+   s->rng ^= s->rng << 17;
+   return (uint32_t) (s->rng >> 32);
 }
 
-void print_tree(Node* n) 
+void bst_print(bst_node* n) 
 {
    if ( n == NULL ) {
       return; 
    } else {
       printf("\n%s", n->pstr);
-      print_tree(n->left);
-      print_tree(n->right); 
+      bst_print(n->left);
+      bst_print(n->right); 
    }
    printf("\n");
 }
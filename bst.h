@@ -4,41 +4,88 @@
  *  redblack.c and redlback.h also*
  * uploaded for a Red Black Tree  *
  **********************************/
+#ifndef BST_H
+#define BST_H
 
-#include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include "dic.h"
 
-#define MAXWORD 50
-#define ON_ERROR(STR) fprintf(stderr, STR); exit(EXIT_FAILURE)
+/*plain: as given, sorted input makes a list
+  treap: random priorities keep expected depth O(log n)
+  splay: lookups move the word found to the root        */
+enum _bst_mode {bst_plain, bst_treap, bst_splay};
+typedef enum _bst_mode bst_mode;
 
-enum _bool {false, true};
-typedef enum _bool bool; 
-
-typedef struct _node {
+typedef struct _bst_node {
+   uint64_t prefix; /*pstr's first 8 bytes, see prefix.h*/
    char *pstr; 
-   struct _node* left;
-   struct _node* right; 
+   struct _bst_node* left;
+   struct _bst_node* right; 
    int max_str; 
-} Node;
+   uint32_t prio; /*treap mode, heap ordered: parent's is larger*/
+} bst_node;
 
-struct _dic {
-   Node* root;
+struct _bst_dic {
+   bst_node* root;
    int max_str;   
    int num_nodes;
+   bst_mode mode;
+   uint64_t rng;    /*treap priorities*/
+   unsigned long num_rotate;
+   struct _hot_cache* hot; /*NULL unless bst_hot_cache was called*/
+};
+typedef struct _bst_dic bst_dic; 
+
+struct _bst_stats {
+   int num_nodes;
+   int height;       /*longest root to node path = max lookup depth,
+                       equal to num_nodes once the tree is a list*/
+   double avg_depth; /*nodes visited by an average hit*/
+   unsigned long num_rotate; /*treap and splay modes*/
+   size_t bytes;     /*dic, nodes and word buffers*/
+   unsigned long hot_lookups; /*0 without a hot cache*/
+   unsigned long hot_hits;
 };
-typedef struct _dic dic; 
+typedef struct _bst_stats bst_stats;
 
 
 /*Create empty dic*/
-dic* dic_init(int size); 
+bst_dic* bst_init(int size); 
+
+/*Create empty dic that keeps itself balanced with mode.
+  Splay mode changes the tree on lookups too, so it is
+  not safe to read from several threads                */
+bst_dic* bst_init_mode(int size, bst_mode mode);
 
 /* Add one element into the dic */
-void dic_insert(dic* s, char* v);
+void bst_insert(bst_dic* s, char* v);
 
 /* Returns true if v is in the array, false elsewise */
-bool dic_isin(dic* s, char* v);
+bool bst_isin(bst_dic* s, char* v);
+
+/* Puts a cache of about entries recently found words in front of
+   bst_isin, 0 removes it. Lookups then write the cache, so a cached
+   dic must be read from one thread only */
+void bst_hot_cache(bst_dic* s, int entries);
+
+/* Calls f on every word in the dic, in sorted order */
+void bst_foreach(bst_dic* s, void (*f)(char* v, void* arg), void* arg);
+
+/* Number of words in the dic, O(1) */
+int bst_size(bst_dic* s);
+
+/* Fills st with the shape of s: height, depths, bytes */
+void bst_get_stats(bst_dic* s, bst_stats* st);
+
+/* Prints the stats from bst_get_stats */
+void bst_print_stats(bst_stats* st);
 
 /* Finish up */
 /* Clears all space used, and sets pointer to NULL */
-void dic_free(dic** s);
+void bst_free(bst_dic** s);
+
+/* Prints the subtree rooted at n */
+void bst_print(bst_node* n);
+
+#endif
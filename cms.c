@@ -0,0 +1,330 @@
+/***************************************
+ *      COUNT-MIN + SPACE SAVING       *
+ *_____________________________________*
+ * - sketch: depth rows of width       *
+ *   counters, a word bumps one per    *
+ *   row and its estimate is the least *
+ *     width = e / epsilon             *
+ *     depth = ln(1 / delta)           *
+ * - conservative update: only rows    *
+ *   at the least count go up, which   *
+ *   keeps estimates tighter           *
+ * - top k (space saving): k words     *
+ *   with counts, a new word takes the *
+ *   least counted slot and inherits   *
+ *   its count as error; any word over *
+ *   total / k is guaranteed a slot    *
+ *_____________________________________*
+ ***************************************/
+#include <string.h>
+#include <math.h>
+#include "cms.h"
+
+#define E 2.71828182845904523536
+#define MAX_DEPTH 16
+#define INDEX_SLOTS 5  /*hsh slots per top k word: 2k words stay under
+                         its load factor, so tombstones left by
+                         replacement force an in-place rehash, never
+                         a resize*/
+
+static uint64_t* row_of(cms* c, int row);
+static void sketch_add(cms* c, char* v, size_t len, unsigned long n,
+                       unsigned long* est);
+static int take_slot(cms* c, char* v, size_t len);
+static void sift_down(cms* c, int pos);
+static void sift_up(cms* c, int pos);
+static void swap_heap(cms* c, int a, int b);
+static char* word_of(cms* c, int slot);
+
+/*Create a counter whose estimates are at most epsilon * total too
+  high with probability 1 - delta, tracking the k most frequent words
+  of up to size - 1 chars exactly*/
+cms* cms_init(int size, int k, double epsilon, double delta)
+{
+   cms* c = NULL;
+
+   if (size < 2 || k < 1){
+      ON_ERROR("Counter needs size >= 2 and k >= 1\n");
+   }
+
+   if (epsilon <= 0 || epsilon >= 1 || delta <= 0 || delta >= 1){
+      ON_ERROR("Counter epsilon and delta must be between 0 and 1\n");
+   }
+
+   c = (cms*) calloc(1, sizeof(cms));
+   if (c == NULL){
+      ON_ERROR("Creation of Counter Failed\n");
+   }
+
+   c->width = (unsigned long) ceil(E / epsilon);
+   c->depth = (int) ceil(log(1 / delta));
+   if (c->depth < 1){
+      c->depth = 1;
+   }
+   if (c->depth > MAX_DEPTH){
+      c->depth = MAX_DEPTH;
+   }
+
+   c->k = k;
+   c->max_str = size;
+   c->rows = (uint64_t*) calloc(c->width * c->depth, sizeof(uint64_t));
+   c->slots = (struct _cms_slot*) calloc(k, sizeof(struct _cms_slot));
+   c->words = (char*) calloc((size_t) k, size);
+   c->heap = (int*) calloc(k, sizeof(int));
+   if (c->rows == NULL || c->slots == NULL || c->words == NULL ||
+       c->heap == NULL){
+      ON_ERROR("Creation of Counter Failed\n");
+   }
+
+   c->index = hsh_init_len(size, k * INDEX_SLOTS);
+   hsh_random_seed(c->seed);
+
+   return c;
+}
+
+/* Counts n more occurrences of v */
+void cms_increment(cms* c, char* v, unsigned long n)
+{
+   struct _cms_slot* slot;
+   unsigned long est;
+   size_t len;
+   int id;
+
+   if ( c == NULL || v == NULL ){
+      ON_ERROR("\nCms_increment() passed NULL value");
+   }
+
+   len = strlen(v);
+   if ( len < 1 || n == 0 ){
+      return;
+   }
+
+   c->total += n;
+   sketch_add(c, v, len, n, &est);
+
+   /*too long for the table: the sketch alone counts it*/
+   if ( len > (size_t) c->max_str - 1 ){
+      return;
+   }
+
+   id = take_slot(c, v, len);
+   slot = &c->slots[id];
+   slot->count += n;
+   sift_down(c, slot->pos);
+}
+
+/* Occurrences of v so far, never less than the truth */
+unsigned long cms_estimate(cms* c, char* v)
+{
+   unsigned long est, count;
+   dic_val val;
+   size_t len;
+
+   if ( c == NULL || v == NULL ){
+      ON_ERROR("\nCms_estimate() passed NULL value");
+   }
+
+   len = strlen(v);
+   if ( len < 1 ){
+      return 0;
+   }
+
+   sketch_add(c, v, len, 0, &est);
+
+   /*both overestimate, so the smaller is closer*/
+   if ( len <= (size_t) c->max_str - 1 && hsh_get(c->index, v, &val) ){
+      count = c->slots[val.i].count;
+      if ( count < est ){
+         est = count;
+      }
+   }
+   return est;
+}
+
+/* Copies up to n heavy hitters, most frequent first, into out; returns
+   how many. Words point into c, valid until the next increment */
+int cms_top(cms* c, cms_item* out, int n)
+{
+   int i, j, id;
+   cms_item item;
+
+   if ( c == NULL || out == NULL || n <= 0 ){
+      return 0;
+   }
+
+   if ( n > c->used ){
+      n = c->used;
+   }
+
+   /*insertion into a best-n list; k is small*/
+   for (i = 0, j = 0; i < c->used; i++){
+      id = c->heap[i];
+      item.word = word_of(c, id);
+      item.count = c->slots[id].count;
+      item.error = c->slots[id].error;
+
+      if ( j < n ){
+         j++;
+      } else if ( item.count <= out[n - 1].count ){
+         continue;
+      }
+
+      id = j - 1;
+      while ( id > 0 && out[id - 1].count < item.count ){
+         out[id] = out[id - 1];
+         id--;
+      }
+      out[id] = item;
+   }
+   return n;
+}
+
+/* Bytes used by sketch and top k table, fixed at init */
+size_t cms_bytes(cms* c)
+{
+   if ( c == NULL ){
+      return 0;
+   }
+
+   return c->width * c->depth * sizeof(uint64_t) +
+          (size_t) c->k * (sizeof(struct _cms_slot) + sizeof(int) +
+                           2 * c->max_str) +
+          (size_t) c->index->arr_len * (sizeof(char*) + sizeof(dic_val));
+}
+
+/* Clears all space used, and sets pointer to NULL */
+void cms_free(cms** c)
+{
+   cms* p_c;
+
+   if ( c == NULL ){
+      return;
+   }
+
+   p_c = *c;
+   if ( p_c == NULL ){
+      return;
+   }
+
+   hsh_free(&p_c->index);
+   free(p_c->rows);
+   free(p_c->slots);
+   free(p_c->words);
+   free(p_c->heap);
+   free(p_c);
+   *c = NULL;
+}
+
+static void sketch_add(cms* c, char* v, size_t len, unsigned long n,
+                       unsigned long* est)
+{
+   /*one keyed hash, row i probes h1 + i * h2 (n = 0 only reads)*/
+   uint64_t h = hsh_siphash(v, len, c->seed);
+   uint32_t h1 = (uint32_t) h, h2 = (uint32_t) (h >> 32) | 1;
+   unsigned long col[MAX_DEPTH];
+   uint64_t least = UINT64_MAX, *cell;
+   int i;
+
+   for (i = 0; i < c->depth; i++){
+      col[i] = ((uint64_t) (h1 + (uint32_t) i * h2) * c->width) >> 32;
+      cell = row_of(c, i) + col[i];
+      if ( *cell < least ){
+         least = *cell;
+      }
+   }
+
+   if ( n > 0 ){
+      least += n;
+      for (i = 0; i < c->depth; i++){
+         cell = row_of(c, i) + col[i];
+         if ( *cell < least ){
+            *cell = least;
+         }
+      }
+   }
+   *est = (unsigned long) least;
+}
+
+static int take_slot(cms* c, char* v, size_t len)
+{
+   /*slot counting v: its own, a free one, or the least counted*/
+   dic_val* val;
+   bool added;
+   int id;
+
+   val = hsh_slot(c->index, v, &added);
+   if ( !added ){
+      return (int) val->i;
+   }
+
+   if ( c->used < c->k ){
+      /*count 0 is the least, so the new slot rises to the root*/
+      id = c->used;
+      c->heap[id] = id;
+      c->slots[id].pos = id;
+      c->used++;
+      sift_up(c, id);
+   } else {
+      /*space saving: v inherits the least count as its error.
+        Removal only leaves a tombstone, so val stays valid*/
+      id = c->heap[0];
+      hsh_remove(c->index, word_of(c, id));
+      c->slots[id].error = c->slots[id].count;
+      c->num_replace++;
+   }
+
+   memcpy(word_of(c, id), v, len + 1);
+   val->i = id;
+   return id;
+}
+
+static void sift_down(cms* c, int pos)
+{
+   int child;
+
+   while ( (child = 2 * pos + 1) < c->used ){
+      if ( child + 1 < c->used &&
+           c->slots[c->heap[child + 1]].count < c->slots[c->heap[child]].count ){
+         child++;
+      }
+      if ( c->slots[c->heap[pos]].count <= c->slots[c->heap[child]].count ){
+         return;
+      }
+      swap_heap(c, pos, child);
+      pos = child;
+   }
+}
+
+static void sift_up(cms* c, int pos)
+{
+   int parent;
+
+   while ( pos > 0 ){
+      parent = (pos - 1) / 2;
+      if ( c->slots[c->heap[parent]].count <= c->slots[c->heap[pos]].count ){
+         return;
+      }
+      swap_heap(c, pos, parent);
+      pos = parent;
+   }
+}
+
+static void swap_heap(cms* c, int a, int b)
+{
+   int id = c->heap[a];
+
+   c->heap[a] = c->heap[b];
+   c->heap[b] = id;
+   c->slots[c->heap[a]].pos = a;
+   c->slots[c->heap[b]].pos = b;
+}
+
+static uint64_t* row_of(cms* c, int row)
+{
+   return c->rows + (size_t) row * c->width;
+}
+
+static char* word_of(cms* c, int slot)
+{
+   return c->words + (size_t) slot * c->max_str;
+}
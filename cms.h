@@ -0,0 +1,71 @@
+/**********************************
+ *    Frequency Counting H file   *
+ *________________________________*
+ * fixed memory word counts over  *
+ * unbounded streams: count-min   *
+ * sketch for every word, exact-  *
+ * ish counts for the top k       *
+ **********************************/
+#ifndef CMS_H
+#define CMS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "dic.h"
+#include "hsh.h"
+
+/*one heavy hitter: the true count is in [count - error, count]*/
+struct _cms_item {
+   char* word;
+   unsigned long count;
+   unsigned long error;
+};
+typedef struct _cms_item cms_item;
+
+/*space saving slot, fixed for as long as it holds a word*/
+struct _cms_slot {
+   unsigned long count;
+   unsigned long error;
+   int pos;   /*index in the min heap*/
+};
+
+struct _cms {
+   uint64_t* rows;   /*depth rows of width counters*/
+   unsigned long width;
+   int depth;
+   uint64_t seed[2];
+   unsigned long total;  /*everything counted so far*/
+   /*space saving top k: hsh maps word -> slot, heap orders slots*/
+   int k;
+   int used;
+   int max_str;
+   hsh_dic* index;
+   struct _cms_slot* slots;
+   char* words;      /*max_str bytes per slot*/
+   int* heap;        /*slot ids, least count first*/
+   unsigned long num_replace;
+};
+typedef struct _cms cms;
+
+/*Create a counter whose estimates are at most epsilon * total too
+  high with probability 1 - delta, tracking the k most frequent words
+  of up to size - 1 chars exactly*/
+cms* cms_init(int size, int k, double epsilon, double delta);
+
+/* Counts n more occurrences of v */
+void cms_increment(cms* c, char* v, unsigned long n);
+
+/* Occurrences of v so far, never less than the truth */
+unsigned long cms_estimate(cms* c, char* v);
+
+/* Copies up to n heavy hitters, most frequent first, into out; returns
+   how many. Words point into c, valid until the next increment */
+int cms_top(cms* c, cms_item* out, int n);
+
+/* Bytes used by sketch and top k table, fixed at init */
+size_t cms_bytes(cms* c);
+
+/* Clears all space used, and sets pointer to NULL */
+void cms_free(cms** c);
+
+#endif
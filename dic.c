@@ -0,0 +1,645 @@
+/***************************************
+ *        DICTIONARY FRONT END         *
+ *_____________________________________*
+ * thin ops table over the namespaced  *
+ * engines so several can live in one  *
+ * binary:                             *
+ *  - hsh_engine : fastest lookups     *
+ *    (hsh_compact_engine: less memory *
+ *     and insertion ordered foreach)  *
+ *  - rb_engine  : ordered, balanced   *
+ *  - bst_engine : cheapest inserts on *
+ *                 random input        *
+ *    (bst_treap_engine and            *
+ *     bst_splay_engine stay balanced) *
+ *  - ad_engine  : packed array while  *
+ *                 small, hsh.c after  *
+ *    (ad_ordered_engine: redblack.c)  *
+ *  - art_engine : radix tree, cost    *
+ *                 set by word length  *
+ *  - rb_persistent_engine : redblack  *
+ *                 with O(1) snapshots *
+ * any of them can get a Bloom filter  *
+ * in front to answer most misses      *
+ *_____________________________________*
+ ***************************************/
+#include <string.h>
+#include "dic.h"
+#include "hsh.h"
+#include "redblack.h"
+#include "bst.h"
+#include "adaptive.h"
+#include "bloom.h"
+#include "art.h"
+
+static size_t key_len(dic* s, char* v);
+static void filter_word(char* v, void* arg);
+
+/*adapters: engines take their own dic types*/
+static void* hsh_ops_init(int size);
+static void* hsh_compact_ops_init(int size);
+static void hsh_ops_insert(void* d, char* v);
+static bool hsh_ops_isin(void* d, char* v);
+static bool hsh_ops_remove(void* d, char* v);
+static bool hsh_ops_get(void* d, char* v, dic_val* out);
+static dic_val* hsh_ops_slot(void* d, char* v, bool* added);
+static void hsh_ops_foreach(void* d, void (*f)(char* v, void* arg), void* arg);
+static void hsh_ops_free(void* d);
+static int hsh_ops_size(void* d);
+static void* rb_ops_init(int size);
+static void rb_ops_insert(void* d, char* v);
+static bool rb_ops_isin(void* d, char* v);
+static bool rb_ops_remove(void* d, char* v);
+static bool rb_ops_get(void* d, char* v, dic_val* out);
+static dic_val* rb_ops_slot(void* d, char* v, bool* added);
+static void rb_ops_foreach(void* d, void (*f)(char* v, void* arg), void* arg);
+static void rb_ops_free(void* d);
+static int rb_ops_size(void* d);
+static int rb_ops_rank(void* d, char* v);
+static char* rb_ops_select(void* d, int k);
+static void* rb_ops_insert_hint(void* d, char* v, void* hint);
+static void* rb_persistent_ops_init(int size);
+static void* rb_ops_snapshot(void* d);
+static void* bst_ops_init(int size);
+static void bst_ops_insert(void* d, char* v);
+static bool bst_ops_isin(void* d, char* v);
+static void bst_ops_foreach(void* d, void (*f)(char* v, void* arg), void* arg);
+static void bst_ops_free(void* d);
+static int bst_ops_size(void* d);
+static void* bst_treap_ops_init(int size);
+static void* bst_splay_ops_init(int size);
+static void* ad_ops_init(int size);
+static void* ad_ordered_ops_init(int size);
+static void ad_ops_insert(void* d, char* v);
+static bool ad_ops_isin(void* d, char* v);
+static bool ad_ops_remove(void* d, char* v);
+static void ad_ops_foreach(void* d, void (*f)(char* v, void* arg), void* arg);
+static void ad_ops_free(void* d);
+static int ad_ops_size(void* d);
+static void* art_ops_init(int size);
+static void art_ops_insert(void* d, char* v);
+static bool art_ops_isin(void* d, char* v);
+static bool art_ops_remove(void* d, char* v);
+static void art_ops_foreach(void* d, void (*f)(char* v, void* arg), void* arg);
+static void art_ops_free(void* d);
+static int art_ops_size(void* d);
+
+static const dic_ops hsh_ops = {
+   "hsh", hsh_ops_init, hsh_ops_insert, hsh_ops_isin, hsh_ops_remove,
+   hsh_ops_get, hsh_ops_slot, hsh_ops_foreach, hsh_ops_free, NULL,
+   hsh_ops_size, NULL, NULL, NULL
+};
+static const dic_ops hsh_compact_ops = {
+   "hsh-compact", hsh_compact_ops_init, hsh_ops_insert, hsh_ops_isin,
+   hsh_ops_remove, hsh_ops_get, hsh_ops_slot, hsh_ops_foreach, hsh_ops_free,
+   NULL, hsh_ops_size, NULL, NULL, NULL
+};
+static const dic_ops rb_ops = {
+   "redblack", rb_ops_init, rb_ops_insert, rb_ops_isin, rb_ops_remove,
+   rb_ops_get, rb_ops_slot, rb_ops_foreach, rb_ops_free, NULL,
+   rb_ops_size, rb_ops_rank, rb_ops_select, rb_ops_insert_hint
+};
+static const dic_ops rb_persistent_ops = {
+   "redblack-persistent", rb_persistent_ops_init, rb_ops_insert, rb_ops_isin,
+   NULL, rb_ops_get, rb_ops_slot, rb_ops_foreach, rb_ops_free,
+   rb_ops_snapshot, rb_ops_size, rb_ops_rank, rb_ops_select, NULL
+};
+static const dic_ops bst_ops = {
+   "bst", bst_ops_init, bst_ops_insert, bst_ops_isin, NULL,
+   NULL, NULL, bst_ops_foreach, bst_ops_free, NULL, bst_ops_size, NULL, NULL,
+   NULL
+};
+static const dic_ops bst_treap_ops = {
+   "bst-treap", bst_treap_ops_init, bst_ops_insert, bst_ops_isin, NULL,
+   NULL, NULL, bst_ops_foreach, bst_ops_free, NULL, bst_ops_size, NULL, NULL,
+   NULL
+};
+static const dic_ops bst_splay_ops = {
+   "bst-splay", bst_splay_ops_init, bst_ops_insert, bst_ops_isin, NULL,
+   NULL, NULL, bst_ops_foreach, bst_ops_free, NULL, bst_ops_size, NULL, NULL,
+   NULL
+};
+static const dic_ops ad_ops = {
+   "adaptive", ad_ops_init, ad_ops_insert, ad_ops_isin, ad_ops_remove,
+   NULL, NULL, ad_ops_foreach, ad_ops_free, NULL, ad_ops_size, NULL, NULL,
+   NULL
+};
+static const dic_ops ad_ordered_ops = {
+   "adaptive-ordered", ad_ordered_ops_init, ad_ops_insert, ad_ops_isin,
+   ad_ops_remove, NULL, NULL, ad_ops_foreach, ad_ops_free, NULL, ad_ops_size,
+   NULL, NULL, NULL
+};
+static const dic_ops art_ops = {
+   "art", art_ops_init, art_ops_insert, art_ops_isin, art_ops_remove,
+   NULL, NULL, art_ops_foreach, art_ops_free, NULL, art_ops_size, NULL, NULL,
+   NULL
+};
+
+/*Create empty dic backed by engine e*/
+dic* dic_init(int size, Engine e)
+{
+   dic* dl = NULL;
+
+   if (size < 1){
+      ON_ERROR("Size must be 1 or greater\n");
+   }
+
+   dl = (dic*) calloc(1, sizeof(dic));
+   if (dl == NULL){
+      ON_ERROR("Creation of Dictionary Failed\n");
+   }
+
+   switch (e){
+      case hsh_engine:
+         dl->ops = &hsh_ops;
+         break;
+      case rb_engine:
+         dl->ops = &rb_ops;
+         break;
+      case bst_engine:
+         dl->ops = &bst_ops;
+         break;
+      case ad_engine:
+         dl->ops = &ad_ops;
+         break;
+      case ad_ordered_engine:
+         dl->ops = &ad_ordered_ops;
+         break;
+      case art_engine:
+         dl->ops = &art_ops;
+         break;
+      case rb_persistent_engine:
+         dl->ops = &rb_persistent_ops;
+         break;
+      case bst_treap_engine:
+         dl->ops = &bst_treap_ops;
+         break;
+      case bst_splay_engine:
+         dl->ops = &bst_splay_ops;
+         break;
+      case hsh_compact_engine:
+         dl->ops = &hsh_compact_ops;
+         break;
+      default:
+         ON_ERROR("Dic_init() passed an unknown engine\n");
+   }
+
+   dl->engine = e;
+   dl->max_str = size;
+   dl->d = dl->ops->init(size);
+
+   return dl;
+}
+
+/* Add one element into the dic */
+void dic_insert(dic* s, char* v)
+{
+   if ( s == NULL || v == NULL ){
+      return;
+   }
+   if ( s->filter != NULL ){
+      bloom_add(s->filter, v, key_len(s, v));
+   }
+   s->ops->insert(s->d, v);
+}
+
+/* Adds v like dic_insert, starting from hint, returns the next hint */
+void* dic_insert_hint(dic* s, char* v, void* hint)
+{
+   if ( s == NULL || v == NULL ){
+      return NULL;
+   }
+   if ( s->ops->insert_hint == NULL ){
+      dic_insert(s, v);
+      return NULL;
+   }
+   if ( s->filter != NULL ){
+      bloom_add(s->filter, v, key_len(s, v));
+   }
+   return s->ops->insert_hint(s->d, v, hint);
+}
+
+/* Returns true if v is in the array, false elsewise */
+bool dic_isin(dic* s, char* v)
+{
+   if ( s == NULL || v == NULL ){
+      return false;
+   }
+   if ( s->filter != NULL && !bloom_maybe(s->filter, v, key_len(s, v)) ){
+      return false;
+   }
+   return s->ops->isin(s->d, v);
+}
+
+/* Removes v, returns true if it was in the dic */
+bool dic_remove(dic* s, char* v)
+{
+   if ( s == NULL || v == NULL || s->ops->remove == NULL ){
+      return false;
+   }
+   return s->ops->remove(s->d, v);
+}
+
+/* Copies the value stored with v into out, returns false if v isn't in */
+bool dic_get(dic* s, char* v, dic_val* out)
+{
+   if ( s == NULL || v == NULL || s->ops->get == NULL ){
+      return false;
+   }
+   if ( s->filter != NULL && !bloom_maybe(s->filter, v, key_len(s, v)) ){
+      return false;
+   }
+   return s->ops->get(s->d, v, out);
+}
+
+/* Stores val with v, adding v if needed */
+void dic_put(dic* s, char* v, dic_val val)
+{
+   dic_val* slot = dic_slot(s, v, NULL);
+
+   if ( slot != NULL ){
+      *slot = val;
+   }
+}
+
+/* Value slot for v, added (zeroed) if missing, in one lookup */
+dic_val* dic_slot(dic* s, char* v, bool* added)
+{
+   if ( s == NULL || v == NULL ){
+      return NULL;
+   }
+   if ( s->ops->slot == NULL ){
+      ON_ERROR("Dic_slot() engine doesn't carry values\n");
+   }
+   if ( s->filter != NULL ){
+      bloom_add(s->filter, v, key_len(s, v));
+   }
+   return s->ops->slot(s->d, v, added);
+}
+
+/* Read only view of s as it is now, in O(1). Only rb_persistent_engine
+   can; the view has no Bloom filter. Free it with dic_free */
+dic* dic_snapshot(dic* s)
+{
+   dic* snap = NULL;
+
+   if ( s == NULL ){
+      return NULL;
+   }
+   if ( s->ops->snapshot == NULL ){
+      ON_ERROR("Dic_snapshot() engine can't take snapshots\n");
+   }
+
+   snap = (dic*) calloc(1, sizeof(dic));
+   if (snap == NULL){
+      ON_ERROR("Creation of Snapshot Failed\n");
+   }
+
+   /*copying the filter would cost O(bits), without it the view
+     answers the same, just without the early misses            */
+   snap->ops = s->ops;
+   snap->engine = s->engine;
+   snap->max_str = s->max_str;
+   snap->d = s->ops->snapshot(s->d);
+   return snap;
+}
+
+/* Clears all space used, and sets pointer to NULL */
+void dic_free(dic** s)
+{
+   dic* p_d;
+
+   if ( s == NULL ){
+      return;
+   }
+
+   p_d = *s;
+   if ( p_d == NULL ){
+      return;
+   }
+
+   p_d->ops->free(p_d->d);
+   bloom_free(&p_d->filter);
+   free(p_d);
+   *s = NULL;
+}
+
+/* Number of words in the dic, O(1) */
+int dic_size(dic* s)
+{
+   if ( s == NULL ){
+      return 0;
+   }
+   return s->ops->size(s->d);
+}
+
+/* Number of words sorting before v (v need not be in), O(log n) */
+int dic_rank(dic* s, char* v)
+{
+   if ( s == NULL || v == NULL ){
+      return 0;
+   }
+   if ( s->ops->rank == NULL ){
+      ON_ERROR("Dic_rank() engine doesn't keep subtree sizes\n");
+   }
+   return s->ops->rank(s->d, v);
+}
+
+/* The k-th word in sorted order, counting from 0, or NULL */
+char* dic_select(dic* s, int k)
+{
+   if ( s == NULL ){
+      return NULL;
+   }
+   if ( s->ops->select == NULL ){
+      ON_ERROR("Dic_select() engine doesn't keep subtree sizes\n");
+   }
+   return s->ops->select(s->d, k);
+}
+
+/* Calls f on every word (sorted for the tree engines) */
+void dic_foreach(dic* s, void (*f)(char* v, void* arg), void* arg)
+{
+   if ( s == NULL || f == NULL ){
+      return;
+   }
+   s->ops->foreach(s->d, f, arg);
+}
+
+/* Puts a Bloom filter in front of s, words already in are added */
+void dic_filter(dic* s, long expected, double fp_rate)
+{
+   if ( s == NULL ){
+      return;
+   }
+
+   bloom_free(&s->filter);
+   s->filter = bloom_init(expected, fp_rate);
+   dic_foreach(s, filter_word, s);
+}
+
+static void filter_word(char* v, void* arg)
+{
+   dic* s = (dic*) arg;
+   bloom_add(s->filter, v, key_len(s, v));
+}
+
+static size_t key_len(dic* s, char* v)
+{
+   /*engines may keep only max_str - 1 bytes, filter on the same*/
+   size_t len = strlen(v);
+
+   if ( len > (size_t) s->max_str - 1 ){
+      len = s->max_str - 1;
+   }
+   return len;
+}
+
+const char* dic_engine_name(dic* s)
+{
+   if (s == NULL){
+      return NULL;
+   }
+   return s->ops->name;
+}
+
+static void* hsh_ops_init(int size)
+{
+   return hsh_init(size);
+}
+
+static void* hsh_compact_ops_init(int size)
+{
+   /*growth only rebuilds the small index, so start small*/
+   return hsh_init_compact(size, 0);
+}
+
+static void hsh_ops_insert(void* d, char* v)
+{
+   hsh_insert((hsh_dic*) d, v);
+}
+
+static bool hsh_ops_isin(void* d, char* v)
+{
+   return hsh_isin((hsh_dic*) d, v);
+}
+
+static bool hsh_ops_remove(void* d, char* v)
+{
+   return hsh_remove((hsh_dic*) d, v);
+}
+
+static bool hsh_ops_get(void* d, char* v, dic_val* out)
+{
+   return hsh_get((hsh_dic*) d, v, out);
+}
+
+static dic_val* hsh_ops_slot(void* d, char* v, bool* added)
+{
+   return hsh_slot((hsh_dic*) d, v, added);
+}
+
+static void hsh_ops_foreach(void* d, void (*f)(char* v, void* arg), void* arg)
+{
+   hsh_foreach((hsh_dic*) d, f, arg);
+}
+
+static void hsh_ops_free(void* d)
+{
+   hsh_dic* p = (hsh_dic*) d;
+   hsh_free(&p);
+}
+
+static int hsh_ops_size(void* d)
+{
+   return hsh_size((hsh_dic*) d);
+}
+
+static void* rb_ops_init(int size)
+{
+   return rb_init(size);
+}
+
+static void rb_ops_insert(void* d, char* v)
+{
+   rb_insert((rb_dic*) d, v);
+}
+
+static bool rb_ops_isin(void* d, char* v)
+{
+   return rb_isin((rb_dic*) d, v);
+}
+
+static bool rb_ops_remove(void* d, char* v)
+{
+   return rb_remove((rb_dic*) d, v);
+}
+
+static bool rb_ops_get(void* d, char* v, dic_val* out)
+{
+   return rb_get((rb_dic*) d, v, out);
+}
+
+static dic_val* rb_ops_slot(void* d, char* v, bool* added)
+{
+   return rb_slot((rb_dic*) d, v, added);
+}
+
+static void rb_ops_foreach(void* d, void (*f)(char* v, void* arg), void* arg)
+{
+   rb_foreach((rb_dic*) d, f, arg);
+}
+
+static void rb_ops_free(void* d)
+{
+   rb_dic* p = (rb_dic*) d;
+   rb_free(&p);
+}
+
+static int rb_ops_size(void* d)
+{
+   return rb_size((rb_dic*) d);
+}
+
+static int rb_ops_rank(void* d, char* v)
+{
+   return rb_rank((rb_dic*) d, v);
+}
+
+static char* rb_ops_select(void* d, int k)
+{
+   return rb_select((rb_dic*) d, k);
+}
+
+static void* rb_ops_insert_hint(void* d, char* v, void* hint)
+{
+   return rb_insert_hint((rb_dic*) d, v, (rb_node*) hint);
+}
+
+static void* rb_persistent_ops_init(int size)
+{
+   return rb_init_persistent(size);
+}
+
+static void* rb_ops_snapshot(void* d)
+{
+   return rb_snapshot((rb_dic*) d);
+}
+
+static void* bst_ops_init(int size)
+{
+   return bst_init(size);
+}
+
+static void bst_ops_insert(void* d, char* v)
+{
+   bst_insert((bst_dic*) d, v);
+}
+
+static bool bst_ops_isin(void* d, char* v)
+{
+   return bst_isin((bst_dic*) d, v);
+}
+
+static void bst_ops_foreach(void* d, void (*f)(char* v, void* arg), void* arg)
+{
+   bst_foreach((bst_dic*) d, f, arg);
+}
+
+static void bst_ops_free(void* d)
+{
+   bst_dic* p = (bst_dic*) d;
+   bst_free(&p);
+}
+
+static int bst_ops_size(void* d)
+{
+   return bst_size((bst_dic*) d);
+}
+
+static void* bst_treap_ops_init(int size)
+{
+   return bst_init_mode(size, bst_treap);
+}
+
+static void* bst_splay_ops_init(int size)
+{
+   return bst_init_mode(size, bst_splay);
+}
+
+static void* ad_ops_init(int size)
+{
+   return ad_init(size, false);
+}
+
+static void* ad_ordered_ops_init(int size)
+{
+   return ad_init(size, true);
+}
+
+static void ad_ops_insert(void* d, char* v)
+{
+   ad_insert((ad_dic*) d, v);
+}
+
+static bool ad_ops_isin(void* d, char* v)
+{
+   return ad_isin((ad_dic*) d, v);
+}
+
+static bool ad_ops_remove(void* d, char* v)
+{
+   return ad_remove((ad_dic*) d, v);
+}
+
+static void ad_ops_foreach(void* d, void (*f)(char* v, void* arg), void* arg)
+{
+   ad_foreach((ad_dic*) d, f, arg);
+}
+
+static void ad_ops_free(void* d)
+{
+   ad_dic* p = (ad_dic*) d;
+   ad_free(&p);
+}
+
+static int ad_ops_size(void* d)
+{
+   return ad_size((ad_dic*) d);
+}
+
+static void* art_ops_init(int size)
+{
+   return art_init(size);
+}
+
+static void art_ops_insert(void* d, char* v)
+{
+   art_insert((art_dic*) d, v);
+}
+
+static bool art_ops_isin(void* d, char* v)
+{
+   return art_isin((art_dic*) d, v);
+}
+
+static bool art_ops_remove(void* d, char* v)
+{
+   return art_remove((art_dic*) d, v);
+}
+
+static void art_ops_foreach(void* d, void (*f)(char* v, void* arg), void* arg)
+{
+   art_foreach((art_dic*) d, f, arg);
+}
+
+static void art_ops_free(void* d)
+{
+   art_dic* p = (art_dic*) d;
+   art_free(&p);
+}
+
+static int art_ops_size(void* d)
+{
+   return art_size((art_dic*) d);
+}
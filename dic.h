@@ -0,0 +1,122 @@
+/**********************************
+ *   Dictionary Front End Header  *
+ *________________________________*
+ *  one dic API, engine chosen at *
+ *  dic_init time:                *
+ *   - hsh.c      (double hashing)*
+ *   - redblack.c (red black tree)*
+ *   - bst.c      (simple BST)    *
+ *   - adaptive.c (sized by count)*
+ **********************************/
+#ifndef DIC_H
+#define DIC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAXWORD 50
+#define ON_ERROR(STR) fprintf(stderr, STR); exit(EXIT_FAILURE)
+
+enum _bool {false, true};
+typedef enum _bool bool;
+
+/*payload kept with a word by the value carrying engines*/
+union _dic_val {
+   void* p;
+   long long i;
+   double d;
+};
+typedef union _dic_val dic_val;
+
+enum _engine {hsh_engine, rb_engine, bst_engine, ad_engine, ad_ordered_engine,
+                art_engine, rb_persistent_engine, bst_treap_engine,
+                bst_splay_engine, hsh_compact_engine};
+typedef enum _engine Engine;
+
+/*one table of function pointers per engine*/
+struct _dic_ops {
+   const char* name;
+   void* (*init)(int size);
+   void  (*insert)(void* d, char* v);
+   bool  (*isin)(void* d, char* v);
+   bool  (*remove)(void* d, char* v); /*NULL if unsupported*/
+   bool  (*get)(void* d, char* v, dic_val* out); /*NULL if no values*/
+   dic_val* (*slot)(void* d, char* v, bool* added);
+   void  (*foreach)(void* d, void (*f)(char* v, void* arg), void* arg);
+   void  (*free)(void* d);
+   void* (*snapshot)(void* d); /*NULL if unsupported*/
+   int   (*size)(void* d);
+   int   (*rank)(void* d, char* v); /*NULL unless order statistic*/
+   char* (*select)(void* d, int k);  /*NULL unless order statistic*/
+   void* (*insert_hint)(void* d, char* v, void* hint); /*NULL: no fingers*/
+};
+typedef struct _dic_ops dic_ops;
+
+struct _dic {
+   const dic_ops* ops;
+   void* d;
+   Engine engine;
+   int max_str;
+   struct _bloom* filter; /*NULL unless dic_filter was called*/
+};
+typedef struct _dic dic;
+
+/*Create empty dic backed by engine e*/
+dic* dic_init(int size, Engine e);
+
+/* Add one element into the dic */
+void dic_insert(dic* s, char* v);
+
+/* Adds v like dic_insert, searching from hint: what the last call
+   returned, or NULL. Returns the hint for the next call. Near sorted
+   streams skip most of the descent on rb_engine; other engines just
+   insert and return NULL */
+void* dic_insert_hint(dic* s, char* v, void* hint);
+
+/* Returns true if v is in the array, false elsewise */
+bool dic_isin(dic* s, char* v);
+
+/* Removes v, returns true if it was in the dic.
+   Engines without removal (bst*, rb_persistent) always return false */
+bool dic_remove(dic* s, char* v);
+
+/* Copies the value stored with v into out, returns false if v isn't in
+   (always false for engines without values: bst*, adaptive*, art) */
+bool dic_get(dic* s, char* v, dic_val* out);
+
+/* Stores val with v, adding v if needed */
+void dic_put(dic* s, char* v, dic_val val);
+
+/* Value slot for v, added (zeroed) if missing, in one lookup.
+   Valid until the dic next changes */
+dic_val* dic_slot(dic* s, char* v, bool* added);
+
+/* Calls f on every word (sorted for the tree engines) */
+void dic_foreach(dic* s, void (*f)(char* v, void* arg), void* arg);
+
+/* Puts a Bloom filter sized for expected words at false positive
+   rate fp_rate in front of s, so most misses skip the engine */
+void dic_filter(dic* s, long expected, double fp_rate);
+
+/* Read only view of s as it is now, in O(1). Only rb_persistent_engine
+   can; the view has no Bloom filter. Free it with dic_free */
+dic* dic_snapshot(dic* s);
+
+/* Number of words in the dic, O(1) */
+int dic_size(dic* s);
+
+/* Number of words sorting before v (v need not be in), O(log n).
+   Only rb_engine and rb_persistent_engine keep the subtree sizes */
+int dic_rank(dic* s, char* v);
+
+/* The k-th word in sorted order, counting from 0, or NULL if k is out
+   of range. O(log n), same engines as dic_rank */
+char* dic_select(dic* s, int k);
+
+/* Clears all space used, and sets pointer to NULL */
+void dic_free(dic** s);
+
+/* Name of the engine behind s, e.g. "hsh" */
+const char* dic_engine_name(dic* s);
+
+#endif
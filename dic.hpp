@@ -0,0 +1,594 @@
+/***************************************
+ *       C++ DICTIONARY TEMPLATE       *
+ *_____________________________________*
+ * dict::dictionary<Backend, MaxLen,   *
+ *                  Hash, Compare>     *
+ * - MaxLen is max_str: words keep at  *
+ *   most MaxLen - 1 chars             *
+ * - MaxLen <= DIC_INLINE_MAX: words   *
+ *   are zero padded key<MaxLen>s      *
+ *   stored in line, and Hash and      *
+ *   Compare run over a compile time   *
+ *   width, so they inline and unroll  *
+ *     hsh_backend: hsh.c's double     *
+ *       hashing, rewritten over a     *
+ *       key vector                    *
+ *     rb_backend:  std::set, itself a *
+ *       red black tree, so compares   *
+ *       inline on the fixed keys;     *
+ *       redblack.c calls strcmp and   *
+ *       key_compare on char*s         *
+ *     bst_backend: bst.c's plain bst  *
+ * - longer words go to the C engines  *
+ *   (link hsh.c, redblack.c, bst.c,   *
+ *   hot.c); Hash and Compare unused   *
+ * - hsh_backend and rb_backend share  *
+ *   no code with hsh.c or redblack.c: *
+ *   no stats, rank/select or hot      *
+ *   cache, so timings through them    *
+ *   don't measure the C engines       *
+ * header only, C++11                  *
+ *_____________________________________*
+ ***************************************/
+#ifndef DIC_HPP
+#define DIC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <set>
+#include <vector>
+
+#define DIC_INLINE_MAX 64
+
+/*the C engines; declared here as dic.h's enum bool clashes with
+  C++'s (it is an int, which is what the engines return)       */
+extern "C" {
+   struct _hsh_dic;
+   struct _rb_dic;
+   struct _bst_dic;
+   struct _hsh_dic* hsh_init_len(int size, int len);
+   void hsh_insert(struct _hsh_dic* s, char* v);
+   int hsh_isin(struct _hsh_dic* s, char* v);
+   int hsh_remove(struct _hsh_dic* s, char* v);
+   void hsh_foreach(struct _hsh_dic* s, void (*f)(char* v, void* arg), void* arg);
+   void hsh_free(struct _hsh_dic** s);
+   struct _rb_dic* rb_init(int size);
+   void rb_insert(struct _rb_dic* s, char* v);
+   int rb_isin(struct _rb_dic* s, char* v);
+   int rb_remove(struct _rb_dic* s, char* v);
+   void rb_foreach(struct _rb_dic* s, void (*f)(char* v, void* arg), void* arg);
+   void rb_free(struct _rb_dic** s);
+   struct _bst_dic* bst_init(int size);
+   void bst_insert(struct _bst_dic* s, char* v);
+   int bst_isin(struct _bst_dic* s, char* v);
+   void bst_foreach(struct _bst_dic* s, void (*f)(char* v, void* arg), void* arg);
+   void bst_free(struct _bst_dic** s);
+}
+
+namespace dict {
+
+struct hsh_backend {};
+struct rb_backend {};
+struct bst_backend {};
+
+/*a word cut to MaxLen - 1 chars, zero padded to whole 8 byte words:
+  padding sorts first, so comparing all of them orders like strcmp*/
+template <std::size_t MaxLen>
+struct key {
+   static_assert(MaxLen >= 2, "MaxLen must leave room for a char");
+   static const std::size_t width = (MaxLen + 7) / 8;
+   char s[width * 8];
+
+   key() { std::memset(s, 0, sizeof(s)); }
+
+   explicit key(const char* v)
+   {
+      std::size_t n = 0;
+
+      std::memset(s, 0, sizeof(s));
+      while ( n < MaxLen - 1 && v[n] != '\0' ){
+         s[n] = v[n];
+         n++;
+      }
+   }
+
+   /*i-th 8 bytes, big endian, so integer order is byte order*/
+   std::uint64_t word(std::size_t i) const
+   {
+      std::uint64_t w = 0;
+      std::size_t b;
+
+      for (b = 0; b < 8; b++){
+         w = (w << 8) | (unsigned char) s[i * 8 + b];
+      }
+      return w;
+   }
+};
+
+/*strcmp's sign, one integer compare per 8 bytes*/
+template <std::size_t MaxLen>
+struct word_compare {
+   int operator()(const key<MaxLen>& a, const key<MaxLen>& b) const
+   {
+      std::size_t i;
+
+      for (i = 0; i < key<MaxLen>::width; i++){
+         if ( a.word(i) != b.word(i) ){
+            return a.word(i) < b.word(i) ? -1 : 1;
+         }
+      }
+      return 0;
+   }
+};
+
+/*SipHash-1-3 like hsh_siphash, over the padded width*/
+template <std::size_t MaxLen>
+struct sip_hash {
+   std::uint64_t operator()(const key<MaxLen>& k, const std::uint64_t seed[2]) const
+   {
+      std::uint64_t v0 = seed[0] ^ 0x736f6d6570736575ULL;
+      std::uint64_t v1 = seed[1] ^ 0x646f72616e646f6dULL;
+      std::uint64_t v2 = seed[0] ^ 0x6c7967656e657261ULL;
+      std::uint64_t v3 = seed[1] ^ 0x7465646279746573ULL;
+      std::uint64_t m;
+      std::size_t i;
+
+      for (i = 0; i <= key<MaxLen>::width; i++){
+         /*last block: the length, as in SipHash*/
+         m = i < key<MaxLen>::width ? load(k.s + i * 8)
+                                    : (std::uint64_t) (key<MaxLen>::width * 8) << 56;
+         v3 ^= m;
+         round(v0, v1, v2, v3);
+         v0 ^= m;
+      }
+
+      v2 ^= 0xff;
+      round(v0, v1, v2, v3);
+      round(v0, v1, v2, v3);
+      round(v0, v1, v2, v3);
+      return v0 ^ v1 ^ v2 ^ v3;
+   }
+
+private:
+   static std::uint64_t rotl(std::uint64_t x, int b) { return (x << b) | (x >> (64 - b)); }
+
+   static std::uint64_t load(const char* p)
+   {
+      std::uint64_t m = 0;
+      int b;
+
+      for (b = 7; b >= 0; b--){
+         m = (m << 8) | (unsigned char) p[b];
+      }
+      return m;
+   }
+
+   static void round(std::uint64_t& v0, std::uint64_t& v1, std::uint64_t& v2,
+                     std::uint64_t& v3)
+   {
+      v0 += v1; v1 = rotl(v1, 13); v1 ^= v0; v0 = rotl(v0, 32);
+      v2 += v3; v3 = rotl(v3, 16); v3 ^= v2;
+      v0 += v3; v3 = rotl(v3, 21); v3 ^= v0;
+      v2 += v1; v1 = rotl(v1, 17); v1 ^= v2; v2 = rotl(v2, 32);
+   }
+};
+
+template <class Backend, std::size_t MaxLen,
+          class Hash = sip_hash<MaxLen>, class Compare = word_compare<MaxLen>,
+          bool Inline = (MaxLen <= DIC_INLINE_MAX)>
+class dictionary;
+
+/*hsh.c's layout with the words in line: prime length, one hash per
+  word gives first slot and step, tombstones, LOAD_FACTOR 0.45. A
+  slot's key says what it is (words are never ""), so a probe reads
+  one array                                                        */
+template <std::size_t MaxLen, class Hash, class Compare>
+class dictionary<hsh_backend, MaxLen, Hash, Compare, true> {
+public:
+   dictionary() : num_elem(0), num_tomb(0)
+   {
+      std::random_device rd;
+
+      seed[0] = ((std::uint64_t) rd() << 32) ^ rd();
+      seed[1] = ((std::uint64_t) rd() << 32) ^ rd();
+      reset(START);
+   }
+
+   dictionary(const dictionary&) = delete;
+   dictionary& operator=(const dictionary&) = delete;
+
+   /*true if v was added, false if it was in*/
+   bool insert(const char* v)
+   {
+      key<MaxLen> k(v);
+      std::size_t i, step, tomb = 0;
+      bool found_tomb = false;
+
+      if ( k.s[0] == '\0' ){
+         return false;
+      }
+      make_room();
+
+      for (slots(k, i, step); state(i) != EMPTY; i = next(i, step)){
+         if ( state(i) == LIVE && Compare()(keys[i], k) == 0 ){
+            return false;
+         }
+         if ( state(i) == TOMB && !found_tomb ){
+            tomb = i;
+            found_tomb = true;
+         }
+      }
+      if ( found_tomb ){
+         i = tomb;
+         num_tomb--;
+      }
+
+      keys[i] = k;
+      num_elem++;
+      return true;
+   }
+
+   bool contains(const char* v) const
+   {
+      return find(key<MaxLen>(v)) >= 0;
+   }
+
+   /*true if v was in*/
+   bool erase(const char* v)
+   {
+      long i = find(key<MaxLen>(v));
+
+      if ( i < 0 ){
+         return false;
+      }
+      keys[i] = key<MaxLen>();
+      keys[i].s[1] = TOMB;
+      num_elem--;
+      num_tomb++;
+      return true;
+   }
+
+   std::size_t size() const { return num_elem; }
+
+   /*f(const char*) for every word, slot order*/
+   template <class F>
+   void for_each(F f) const
+   {
+      std::size_t i;
+
+      for (i = 0; i < keys.size(); i++){
+         if ( state(i) == LIVE ){
+            f((const char*) keys[i].s);
+         }
+      }
+   }
+
+private:
+   enum { EMPTY, TOMB, LIVE };
+   static const std::size_t START = 31;
+   static const std::size_t GROW = 5;
+
+   std::vector<key<MaxLen> > keys;
+   std::size_t num_elem;
+   std::size_t num_tomb;
+   std::uint64_t seed[2];
+
+   long find(const key<MaxLen>& k) const
+   {
+      std::size_t i, step;
+
+      if ( k.s[0] == '\0' ){
+         return -1;
+      }
+      for (slots(k, i, step); state(i) != EMPTY; i = next(i, step)){
+         if ( state(i) == LIVE && Compare()(keys[i], k) == 0 ){
+            return (long) i;
+         }
+      }
+      return -1;
+   }
+
+   void slots(const key<MaxLen>& k, std::size_t& i, std::size_t& step) const
+   {
+      /*as hsh.c: one hash, the low half picks the first slot and
+        the high half the step, which is never 0                */
+      std::uint64_t h = Hash()(k, seed);
+
+      i = (std::size_t) (h % keys.size());
+      step = 1 + (std::size_t) ((h >> 32) % (keys.size() - 1));
+   }
+
+   int state(std::size_t i) const
+   {
+      /*"" with a 1 after it marks a removed word*/
+      return keys[i].s[0] != '\0' ? (int) LIVE : keys[i].s[1];
+   }
+
+   std::size_t next(std::size_t i, std::size_t step) const
+   {
+      i += step;
+      return i >= keys.size() ? i - keys.size() : i;
+   }
+
+   void make_room()
+   {
+      /*grow past LOAD_FACTOR, or just sweep out tombstones when
+        they make up most of the load                          */
+      std::vector<key<MaxLen> > old_keys;
+      std::size_t i, j, step;
+
+      if ( (num_elem + num_tomb) * 100 <= keys.size() * 45 ){
+         return;
+      }
+
+      old_keys.swap(keys);
+      reset(num_tomb > num_elem ? old_keys.size() : prime(old_keys.size() * GROW));
+
+      for (i = 0; i < old_keys.size(); i++){
+         if ( old_keys[i].s[0] == '\0' ){
+            continue;
+         }
+         for (slots(old_keys[i], j, step); state(j) != EMPTY; j = next(j, step)){
+         }
+         keys[j] = old_keys[i];
+      }
+      num_tomb = 0;
+   }
+
+   void reset(std::size_t len)
+   {
+      keys.assign(len, key<MaxLen>());
+   }
+
+   static std::size_t prime(std::size_t n)
+   {
+      std::size_t d;
+
+      for (;; n++){
+         for (d = 2; d * d <= n && n % d != 0; d++){
+         }
+         if ( d * d > n ){
+            return n;
+         }
+      }
+   }
+};
+
+/*std::set is a red black tree; Compare decides its order*/
+template <std::size_t MaxLen, class Hash, class Compare>
+class dictionary<rb_backend, MaxLen, Hash, Compare, true> {
+public:
+   dictionary() {}
+   dictionary(const dictionary&) = delete;
+   dictionary& operator=(const dictionary&) = delete;
+
+   bool insert(const char* v)
+   {
+      key<MaxLen> k(v);
+
+      return k.s[0] != '\0' && tree.insert(k).second;
+   }
+
+   bool contains(const char* v) const
+   {
+      return tree.find(key<MaxLen>(v)) != tree.end();
+   }
+
+   bool erase(const char* v)
+   {
+      return tree.erase(key<MaxLen>(v)) > 0;
+   }
+
+   std::size_t size() const { return tree.size(); }
+
+   /*f(const char*) for every word, sorted*/
+   template <class F>
+   void for_each(F f) const
+   {
+      typename std::set<key<MaxLen>, less>::const_iterator it;
+
+      for (it = tree.begin(); it != tree.end(); ++it){
+         f((const char*) it->s);
+      }
+   }
+
+private:
+   struct less {
+      bool operator()(const key<MaxLen>& a, const key<MaxLen>& b) const
+      {
+         return Compare()(a, b) < 0;
+      }
+   };
+
+   std::set<key<MaxLen>, less> tree;
+};
+
+/*bst.c's plain mode: unbalanced, no removal*/
+template <std::size_t MaxLen, class Hash, class Compare>
+class dictionary<bst_backend, MaxLen, Hash, Compare, true> {
+public:
+   dictionary() : root(NULL), num_nodes(0) {}
+   dictionary(const dictionary&) = delete;
+   dictionary& operator=(const dictionary&) = delete;
+
+   ~dictionary()
+   {
+      /*rotate left children up, free along the right spine*/
+      node* n = root;
+      node* l;
+      node* next;
+
+      while ( n != NULL ){
+         if ( n->left != NULL ){
+            l = n->left;
+            n->left = l->right;
+            l->right = n;
+            n = l;
+            continue;
+         }
+         next = n->right;
+         delete n;
+         n = next;
+      }
+   }
+
+   bool insert(const char* v)
+   {
+      key<MaxLen> k(v);
+      node** at = &root;
+      int compare;
+
+      if ( k.s[0] == '\0' ){
+         return false;
+      }
+      while ( *at != NULL ){
+         compare = Compare()(k, (*at)->k);
+         if ( compare == 0 ){
+            return false;
+         }
+         at = compare < 0 ? &(*at)->left : &(*at)->right;
+      }
+      *at = new node(k);
+      num_nodes++;
+      return true;
+   }
+
+   bool contains(const char* v) const
+   {
+      key<MaxLen> k(v);
+      const node* n = root;
+      int compare;
+
+      while ( n != NULL ){
+         compare = Compare()(k, n->k);
+         if ( compare == 0 ){
+            return true;
+         }
+         n = compare < 0 ? n->left : n->right;
+      }
+      return false;
+   }
+
+   std::size_t size() const { return num_nodes; }
+
+   /*f(const char*) for every word, sorted*/
+   template <class F>
+   void for_each(F f) const
+   {
+      std::vector<const node*> stack;
+      const node* n = root;
+
+      while ( n != NULL || !stack.empty() ){
+         while ( n != NULL ){
+            stack.push_back(n);
+            n = n->left;
+         }
+         n = stack.back();
+         stack.pop_back();
+         f((const char*) n->k.s);
+         n = n->right;
+      }
+   }
+
+private:
+   struct node {
+      key<MaxLen> k;
+      node* left;
+      node* right;
+      explicit node(const key<MaxLen>& key) : k(key), left(NULL), right(NULL) {}
+   };
+
+   node* root;
+   std::size_t num_nodes;
+};
+
+/*long words: the C engine itself, through its namespaced API*/
+template <class Backend> struct engine;
+
+template <> struct engine<hsh_backend> {
+   typedef struct _hsh_dic type;
+   static type* init(int size) { return hsh_init_len(size, 0); }
+   static void insert(type* d, char* v) { hsh_insert(d, v); }
+   static bool isin(type* d, char* v) { return hsh_isin(d, v) != 0; }
+   static bool remove(type* d, char* v) { return hsh_remove(d, v) != 0; }
+   static void foreach(type* d, void (*f)(char*, void*), void* arg) { hsh_foreach(d, f, arg); }
+   static void free(type* d) { hsh_free(&d); }
+};
+
+template <> struct engine<rb_backend> {
+   typedef struct _rb_dic type;
+   static type* init(int size) { return rb_init(size); }
+   static void insert(type* d, char* v) { rb_insert(d, v); }
+   static bool isin(type* d, char* v) { return rb_isin(d, v) != 0; }
+   static bool remove(type* d, char* v) { return rb_remove(d, v) != 0; }
+   static void foreach(type* d, void (*f)(char*, void*), void* arg) { rb_foreach(d, f, arg); }
+   static void free(type* d) { rb_free(&d); }
+};
+
+template <> struct engine<bst_backend> {
+   typedef struct _bst_dic type;
+   static type* init(int size) { return bst_init(size); }
+   static void insert(type* d, char* v) { bst_insert(d, v); }
+   static bool isin(type* d, char* v) { return bst_isin(d, v) != 0; }
+   static void foreach(type* d, void (*f)(char*, void*), void* arg) { bst_foreach(d, f, arg); }
+   static void free(type* d) { bst_free(&d); }
+};
+
+template <class Backend, std::size_t MaxLen, class Hash, class Compare>
+class dictionary<Backend, MaxLen, Hash, Compare, false> {
+public:
+   dictionary() : d(engine<Backend>::init((int) MaxLen)), num_elem(0) {}
+   dictionary(const dictionary&) = delete;
+   dictionary& operator=(const dictionary&) = delete;
+   ~dictionary() { engine<Backend>::free(d); }
+
+   /*the engines don't write through v*/
+   bool insert(const char* v)
+   {
+      if ( v[0] == '\0' || contains(v) ){
+         return false;
+      }
+      engine<Backend>::insert(d, const_cast<char*>(v));
+      num_elem++;
+      return true;
+   }
+
+   bool contains(const char* v) const
+   {
+      return engine<Backend>::isin(d, const_cast<char*>(v));
+   }
+
+   /*hsh and rb only, as in the C engines*/
+   bool erase(const char* v)
+   {
+      if ( !engine<Backend>::remove(d, const_cast<char*>(v)) ){
+         return false;
+      }
+      num_elem--;
+      return true;
+   }
+
+   std::size_t size() const { return num_elem; }
+
+   template <class F>
+   void for_each(F f) const
+   {
+      engine<Backend>::foreach(d, call<F>, &f);
+   }
+
+private:
+   typename engine<Backend>::type* d;
+   std::size_t num_elem;
+
+   template <class F>
+   static void call(char* v, void* arg)
+   {
+      (*static_cast<F*>(arg))((const char*) v);
+   }
+};
+
+}
+
+#endif
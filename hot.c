@@ -0,0 +1,166 @@
+/***************************************
+ *           HOT KEY CACHE             *
+ *_____________________________________*
+ * - a word's hash picks one set of    *
+ *   HOT_WAYS, and 32 bits of it are   *
+ *   the tag: a miss usually costs     *
+ *   one cache line, a hit two         *
+ * - only words the tree has found go  *
+ *   in, so an insert can't make an    *
+ *   entry wrong, only a removal can   *
+ * - round robin refill: hot words get *
+ *   re-added as soon as they drop out *
+ *_____________________________________*
+ ***************************************/
+#include <string.h>
+#include "hot.h"
+#include "hsh.h"
+
+static int find_way(hot_cache* c, char* v, size_t len, hot_set** set,
+                    uint32_t* tag);
+static char* word_at(hot_cache* c, hot_set* set, int way);
+
+/*Create a cache of about entries words for a dic of word size max_str*/
+hot_cache* hot_init(int entries, int max_str)
+{
+   hot_cache* c = NULL;
+
+   if (entries < 1 || max_str < 2){
+      ON_ERROR("Hot cache needs entries >= 1 and size >= 2\n");
+   }
+
+   c = (hot_cache*) calloc(1, sizeof(hot_cache));
+   if (c == NULL){
+      ON_ERROR("Creation of Hot Cache Failed\n");
+   }
+
+   c->num_sets = (entries + HOT_WAYS - 1) / HOT_WAYS;
+   c->max_str = max_str;
+   c->sets = (hot_set*) calloc(c->num_sets, sizeof(hot_set));
+   c->words = (char*) calloc((size_t) c->num_sets * HOT_WAYS, max_str);
+   if (c->sets == NULL || c->words == NULL){
+      ON_ERROR("Creation of Hot Cache Failed\n");
+   }
+
+   hsh_random_seed(c->seed);
+
+   return c;
+}
+
+/* True if v is cached (so known to be in the dic) */
+bool hot_find(hot_cache* c, char* v)
+{
+   hot_set* set;
+   uint32_t tag;
+   size_t len;
+
+   if ( c == NULL || v == NULL ){
+      return false;
+   }
+
+   len = strlen(v);
+   if ( len > (size_t) c->max_str - 1 ){
+      return false;
+   }
+
+   c->num_lookups++;
+   if ( find_way(c, v, len, &set, &tag) < 0 ){
+      return false;
+   }
+   c->num_hits++;
+   return true;
+}
+
+/* Remembers v, just found in the dic */
+void hot_add(hot_cache* c, char* v)
+{
+   hot_set* set;
+   uint32_t tag;
+   size_t len;
+   int way;
+
+   if ( c == NULL || v == NULL ){
+      return;
+   }
+
+   len = strlen(v);
+   if ( len > (size_t) c->max_str - 1 ){
+      return;
+   }
+
+   if ( find_way(c, v, len, &set, &tag) >= 0 ){
+      return;
+   }
+
+   way = (int) set->next;
+   set->next = (way + 1) % HOT_WAYS;
+   set->tags[way] = tag;
+   memcpy(word_at(c, set, way), v, len + 1);
+}
+
+/* Forgets v, about to leave the dic */
+void hot_drop(hot_cache* c, char* v)
+{
+   hot_set* set;
+   uint32_t tag;
+   size_t len;
+   int way;
+
+   if ( c == NULL || v == NULL ){
+      return;
+   }
+
+   len = strlen(v);
+   if ( len > (size_t) c->max_str - 1 ){
+      return;
+   }
+
+   way = find_way(c, v, len, &set, &tag);
+   if ( way >= 0 ){
+      set->tags[way] = 0;
+   }
+}
+
+/* Clears all space used, and sets pointer to NULL */
+void hot_free(hot_cache** c)
+{
+   hot_cache* p_c;
+
+   if ( c == NULL ){
+      return;
+   }
+
+   p_c = *c;
+   if ( p_c == NULL ){
+      return;
+   }
+
+   free(p_c->sets);
+   free(p_c->words);
+   free(p_c);
+   *c = NULL;
+}
+
+static int find_way(hot_cache* c, char* v, size_t len, hot_set** set,
+                    uint32_t* tag)
+{
+   /*way holding v, or -1; set and tag are filled either way*/
+   uint64_t h = hsh_siphash(v, len, c->seed);
+   int way;
+
+   *set = c->sets + (((h >> 32) * (uint64_t) c->num_sets) >> 32);
+   *tag = (uint32_t) h | 1;
+
+   for (way = 0; way < HOT_WAYS; way++){
+      if ( (*set)->tags[way] == *tag &&
+           memcmp(word_at(c, *set, way), v, len + 1) == 0 ){
+         return way;
+      }
+   }
+   return -1;
+}
+
+static char* word_at(hot_cache* c, hot_set* set, int way)
+{
+   return c->words + ((size_t) (set - c->sets) * HOT_WAYS + way) * c->max_str;
+}
@@ -0,0 +1,52 @@
+/**********************************
+ *     Hot Key Cache H file       *
+ *________________________________*
+ * small set associative cache of *
+ * words a tree recently found,   *
+ * checked before the descent     *
+ **********************************/
+#ifndef HOT_H
+#define HOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "dic.h"
+
+#define HOT_WAYS 4
+
+/*one set, two to a cache line; only a tag match reads the word*/
+struct _hot_set {
+   uint32_t tags[HOT_WAYS]; /*0 = empty*/
+   uint32_t next;           /*way to refill, round robin*/
+   uint32_t pad[3];
+};
+typedef struct _hot_set hot_set;
+
+struct _hot_cache {
+   hot_set* sets;
+   char* words;   /*HOT_WAYS * max_str bytes per set*/
+   int num_sets;
+   int max_str;
+   uint64_t seed[2];
+   /*for sizing: hits / lookups is the share of descents saved*/
+   unsigned long num_lookups;
+   unsigned long num_hits;
+};
+typedef struct _hot_cache hot_cache;
+
+/*Create a cache of about entries words for a dic of word size max_str*/
+hot_cache* hot_init(int entries, int max_str);
+
+/* True if v is cached (so known to be in the dic) */
+bool hot_find(hot_cache* c, char* v);
+
+/* Remembers v, just found in the dic */
+void hot_add(hot_cache* c, char* v);
+
+/* Forgets v, about to leave the dic */
+void hot_drop(hot_cache* c, char* v);
+
+/* Clears all space used, and sets pointer to NULL */
+void hot_free(hot_cache** c);
+
+#endif
@@ -4,43 +4,155 @@
  *  QUADRATIC PROBING              *
  *   - Avoids clustering           *
  *   - resizes                     *
+ *   - seeded SipHash-1-3 per table*
+ *     (pluggable: hsh_set_hash)   *
+ *   - optional huge page / NUMA   *
+ *     backing (hsh_init_huge)     *
+ *   - optional compact layout:    *
+ *     small index over a dense,   *
+ *     ordered entry array         *
+ *     (hsh_init_compact)          *
  ***********************************/
+#define _GNU_SOURCE /*MAP_HUGETLB, MADV_HUGEPAGE, syscall()*/
 #include <string.h>
 #include <assert.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "hsh.h"
 
 #define HASH_SEED 5381
+#define SIP_C0 0x736f6d6570736575ULL
+#define SIP_C1 0x646f72616e646f6dULL
+#define SIP_C2 0x6c7967656e657261ULL
+#define SIP_C3 0x7465646279746573ULL
+#define ROTL(X, B) (((X) << (B)) | ((X) >> (64 - (B))))
+#define SIPROUND v0 += v1; v1 = ROTL(v1, 13); v1 ^= v0; v0 = ROTL(v0, 32); \
+                 v2 += v3; v3 = ROTL(v3, 16); v3 ^= v2;                   \
+                 v0 += v3; v3 = ROTL(v3, 21); v3 ^= v0;                   \
+                 v2 += v1; v1 = ROTL(v1, 17); v1 ^= v2; v2 = ROTL(v2, 32)
 #define L_START 970031
 #define START 31
 #define ARR_INCREASE 5
 #define LOAD_FACTOR 0.45
-#define ELEMENT_RATIO (float) s->num_elem / (float) s->arr_len
-#define PRIME 7
+#define ELEMENT_RATIO (float) (s->num_elem + s->num_tomb) / (float) s->arr_len
+#define TOMB_HEAVY s->num_tomb > s->num_elem
+
+#define CACHE_LOAD 0.8   /*caches only rehash (in place) past this*/
+#define CACHE_WAYS 8     /*probe slots a new word may evict from*/
+#define IS_CACHE s->ref != NULL
+#define MISS_SAMPLES 4096 /*synthetic misses probed by hsh_get_stats*/
+
+#define IS_COMPACT s->ent_off != NULL
+#define IDX_EMPTY 0
+#define IDX_DUMMY 1      /*removed entry: probes continue past it*/
+#define ENT_START 16     /*first entry array, doubling from here*/
+#define IDX_INCREASE 2   /*a rebuild is cheap, so grow the index less*/
+
+#define PAR_MIN 65536    /*smaller tables rehash faster on one thread*/
+#define MAX_THREADS 64
+#define PAR_REHASH s->threads > 1 && s->num_elem >= PAR_MIN
+
+/*one rehash worker's share of the old slots*/
+struct _rehash_job {
+   hsh_dic* s;
+   char** old_arr;
+   dic_val* old_vals;
+   unsigned char* old_ref;
+   int lo;
+   int hi;
+};
+
+#define HUGE_PAGE (2UL << 20)   /*mappings round up to this*/
+#define ARENA_MAX (64UL << 20)  /*word chunks double up to this*/
+#define IS_HUGE s->huge != 0
+#ifndef MPOL_BIND
+#define MPOL_BIND 2
+#define MPOL_INTERLEAVE 3
+#endif
+
+/*words of a huge page dic: fixed size slots carved from mapped
+  chunks, removed words go on a free list threaded through them */
+struct _arena_chunk {
+   struct _arena_chunk* next;
+   size_t len;
+};
+
+struct _hsh_arena {
+   struct _arena_chunk* chunks;
+   char* next;   /*unused tail of the newest chunk*/
+   char* end;
+   char* free;   /*first freed slot, each holds the next*/
+   size_t slot;  /*max_str rounded up to a pointer*/
+   size_t grow;  /*size of the next chunk*/
+   size_t mapped;
+};
+
+/*removed words leave a tombstone so probe chains stay unbroken*/
+static char tombstone[1];
+#define TOMB tombstone
 
 /*primary*/
-dic* my_dic_init(int size, int len);
-unsigned long hash(dic* s, char* str, unsigned long count);
-unsigned long hash1(char* str, int seed);
-unsigned long hash2(char* str);
-void insert_word(dic* s, char* v);
-void resize(dic* s);
-void rehash(dic* s);
+static hsh_dic* my_dic_init(int size, int len);
+static void hash(hsh_dic* s, char* str, unsigned long* key, unsigned long* step);
+static unsigned long probe(hsh_dic* s, unsigned long key, unsigned long step);
+static void seed_table(hsh_dic* s);
+static int probe_len(hsh_dic* s, char* v, bool* found);
+static void add_probe(unsigned long* hist, int len);
+static double now_secs(void);
+static unsigned long insert_word(hsh_dic* s, char* v, bool* added);
+static void make_room(hsh_dic* s);
+static unsigned long place_word(hsh_dic* s, char* v, bool* added);
+static unsigned long cache_word(hsh_dic* s, char* v, bool* added);
+static void clock_evict(hsh_dic* s);
+static void touch(hsh_dic* s, unsigned long key);
+static void resize(hsh_dic* s);
+static void rehash(hsh_dic* s);
+static void* big_alloc(hsh_dic* s, size_t bytes, size_t* mapped);
+static void* grow_mapping(hsh_dic* s, void* old, size_t width, int new_len,
+                          size_t* mapped);
+static void big_free(void* p, size_t mapped);
+static char* alloc_str(hsh_dic* s);
+static void free_str(hsh_dic* s, char* str);
+static void par_rehash(hsh_dic* s, bool grow);
+static void* rehash_worker(void* arg);
+
+/*compact layout*/
+static void compact_layout(hsh_dic* s);
+static long compact_find(hsh_dic* s, char* v, unsigned long* slot, int* probes);
+static long compact_place(hsh_dic* s, char* v, bool* added);
+static bool compact_remove(hsh_dic* s, char* v);
+static void compact_room(hsh_dic* s);
+static void compact_rebuild(hsh_dic* s, int new_len);
+static void grow_ents(hsh_dic* s, int cap);
+static void grow_words(hsh_dic* s, size_t need);
+static int ent_max(hsh_dic* s);
+static char* ent_word(hsh_dic* s, long e);
+static unsigned long idx_get(hsh_dic* s, unsigned long slot);
+static void idx_set(hsh_dic* s, unsigned long slot, unsigned long e);
+static uint64_t word_hash(hsh_dic* s, char* str);
+static void split_hash(hsh_dic* s, uint64_t h, unsigned long* key,
+                       unsigned long* step);
 
 /*helper*/
-void add_word(dic* s, char* v, unsigned long index);
-void arr_add_word(char** temp_arr, dic* s, int i, int* arr_ind);
-char* init_str(dic* s, unsigned long index);
-void arr_init_str(char** arr, unsigned long index, int max_string);
-bool is_empty(dic* s, unsigned long index);
-bool is_same(dic* s, char* v, unsigned long index);
-bool isprime(int num);
-int prime_gen(int start_num);
-int max (int x, int y); 
-void insert_null_check(dic* s, char* v);
-char** init_arr(char** arr, int len);
-void print_dic(dic* s);
+static void add_word(hsh_dic* s, char* v, unsigned long index);
+static void arr_add_word(char** temp_arr, dic_val* temp_vals, hsh_dic* s, int i, int* arr_ind);
+static void init_vals(hsh_dic* s);
+static long find_word(hsh_dic* s, char* v);
+static char* init_str(hsh_dic* s, unsigned long index);
+static void arr_init_str(char** arr, unsigned long index, int max_string);
+static bool is_empty(hsh_dic* s, unsigned long index);
+static bool is_live(hsh_dic* s, unsigned long index);
+static bool is_same(hsh_dic* s, char* v, unsigned long index);
+static bool isprime(int num);
+static unsigned long online_nodes(void);
+static int prime_gen(int start_num);
+static char** init_arr(char** arr, int len);
 
 /*Create empty dic*/
-dic* dic_init(int size)
+hsh_dic* hsh_init(int size)
 {
    if (size < 1){
       ON_ERROR("\nSize must be greater than 1");
@@ -54,19 +166,115 @@ dic* dic_init(int size)
    return my_dic_init(size, L_START); 
 }
 
+/*Create empty dic with at least len slots (rounded up to a prime)*/
+hsh_dic* hsh_init_len(int size, int len)
+{
+   if (size < 1){
+      ON_ERROR("\nSize must be greater than 1");
+   }
+
+   if (len < START){
+      len = START;
+   }
+
+   return my_dic_init(size, prime_gen(len)); 
+}
+
+/*Create empty dic with at least len slots whose slot array, values
+  and words are mapped in huge pages, and placed by NUMA policy.
+  HSH_HUGE_EXPLICIT falls back to THP when no huge page is reserved,
+  a kernel without NUMA leaves the pages where they land           */
+hsh_dic* hsh_init_huge(int size, int len, int flags, unsigned long nodemask)
+{
+   hsh_dic* dl = NULL;
+
+   dl = hsh_init_len(size, len);
+   if ( flags == 0 ){
+      return dl;
+   }
+
+   dl->huge = flags;
+   dl->nodemask = nodemask ? nodemask : online_nodes();
+
+   free(dl->arr);
+   dl->arr = (char**) big_alloc(dl, (size_t) dl->arr_len * sizeof(char*),
+                                &dl->arr_map);
+
+   dl->arena = (struct _hsh_arena*) calloc(1, sizeof(struct _hsh_arena));
+   if ( dl->arena == NULL ){
+      ON_ERROR("Creation of Word Arena Failed\n");
+   }
+   dl->arena->slot = (size + sizeof(char*) - 1) / sizeof(char*) * sizeof(char*);
+   dl->arena->grow = HUGE_PAGE;
+
+   return dl;
+}
+
+/*Create empty dic with at least len slots in the compact layout:
+  an index of 1, 2 or 4 byte entry numbers (width set by the table
+  size) over a dense entry array in insertion order, whose words
+  are packed back to back. Empty slots cost the index width, not a
+  pointer, and a word costs its length, not max_str plus malloc's
+  header                                                          */
+hsh_dic* hsh_init_compact(int size, int len)
+{
+   hsh_dic* dl = hsh_init_len(size, len);
+
+   free(dl->arr);
+   dl->arr = NULL;
+   compact_layout(dl);
+   grow_ents(dl, ENT_START < ent_max(dl) ? ENT_START : ent_max(dl));
+
+   return dl;
+}
+
+/*Create a bounded cache: at most max_elem words, or as many as fit
+  in max_bytes when that is non-zero. Never resizes, full caches
+  evict with CLOCK (a reference byte per slot)                     */
+hsh_dic* hsh_init_cache(int size, int max_elem, size_t max_bytes)
+{
+   hsh_dic* dl = NULL;
+   size_t per_word;
+
+   if (size < 1){
+      ON_ERROR("\nSize must be greater than 1");
+   }
+
+   if (max_bytes > 0){
+      /*word buffer, plus slot pointer and ref byte at LOAD_FACTOR*/
+      per_word = size + (size_t) ((sizeof(char*) + 1) / LOAD_FACTOR) + 1;
+      if (max_elem < 1 || (size_t) max_elem > max_bytes / per_word){
+         max_elem = (int) (max_bytes / per_word);
+      }
+   }
+
+   if (max_elem < 1){
+      ON_ERROR("\nCache must hold at least one word");
+   }
+
+   dl = my_dic_init(size, prime_gen((int) (max_elem / LOAD_FACTOR) + 1));
+   dl->max_elem = max_elem;
+   dl->ref = (unsigned char*) calloc(dl->arr_len, sizeof(unsigned char));
+   if (dl->ref == NULL){
+      ON_ERROR("Creation of Reference Array Failed\n");
+   }
+
+   return dl;
+}
+
 /*Create empty dic with array length len*/
-dic* my_dic_init(int size, int len)
+static hsh_dic* my_dic_init(int size, int len)
 {
    int i = 0;
-   dic* dl = NULL;
+   hsh_dic* dl = NULL;
 
    /*get enough space dic struct*/
-   dl = (dic*) calloc(1,sizeof(dic));
+   dl = (hsh_dic*) calloc(1,sizeof(hsh_dic));
    if(dl == NULL){
       ON_ERROR("Creation of Dictionary Failed\n");
    }
 
-   /*calloc space for char** arr in dic*/
+   /*calloc space for char** arr in hsh_dic*/
    dl->arr = (char**) calloc(len,sizeof(char*));
    if (dl->arr == NULL){
       ON_ERROR("Creation of Array Failed\n");
@@ -80,13 +288,16 @@ dic* my_dic_init(int size, int len)
 
    dl->max_str = size;
    dl->num_elem = 0;
+   dl->num_tomb = 0;
    dl->arr_len = len; 
+   dl->hash = hsh_siphash;
+   seed_table(dl);
 
    return dl;
 }
 
 /* Add one element into the dic */
-void dic_insert(dic* s, char* v)
+void hsh_insert(hsh_dic* s, char* v)
 {
    if ( v == NULL || s == NULL){
       return; 
@@ -96,46 +307,393 @@ void dic_insert(dic* s, char* v)
       return; 
    }
 
-   /*resize arr if too full*/
+   if ( IS_COMPACT ){
+      compact_place(s, v, NULL);
+      return;
+   }
+
+   make_room(s);
+   place_word(s, v, NULL); 
+}
+
+/* Copies the value stored with v into out, returns false if v isn't in */
+bool hsh_get(hsh_dic* s, char* v, dic_val* out)
+{
+   long key;
+
+   if ( s == NULL || v == NULL ){
+      ON_ERROR("\nHsh_get() passed NULL value"); 
+   }
+
+   if ( IS_COMPACT ){
+      key = compact_find(s, v, NULL, NULL);
+   } else {
+      key = find_word(s, v);
+   }
+   if ( key < 0 ){
+      return false; 
+   }
+   touch(s, key);
+
+   if ( out != NULL ){
+      if ( s->vals != NULL ){
+         *out = s->vals[key];
+      } else {
+         memset(out, 0, sizeof(dic_val));
+      }
+   }
+   return true; 
+}
+
+/* Stores val with v, adding v if needed */
+void hsh_put(hsh_dic* s, char* v, dic_val val)
+{
+   dic_val* slot = hsh_slot(s, v, NULL);
+
+   if ( slot != NULL ){
+      *slot = val;
+   }
+}
+
+/* Value slot for v, added (zeroed) if missing. Valid until the next
+   insert, which may move the table */
+dic_val* hsh_slot(hsh_dic* s, char* v, bool* added)
+{
+   unsigned long key;
+
+   if ( v == NULL || s == NULL ){
+      return NULL; 
+   }
+
+   if ( strlen(v) < 1 ){
+      return NULL; 
+   }
+
+   if ( s->vals == NULL ){
+      init_vals(s);
+   }
+
+   if ( IS_COMPACT ){
+      key = (unsigned long) compact_place(s, v, added);
+      return &s->vals[key];
+   }
+
+   make_room(s);
+   key = place_word(s, v, added);
+   return &s->vals[key];
+}
+
+static void make_room(hsh_dic* s)
+{
+   /*caches never grow, only sweep out the clock's tombstones*/
+   if ( IS_CACHE ){
+      if ( ELEMENT_RATIO > CACHE_LOAD ){
+         if ( PAR_REHASH ){
+            par_rehash(s, false);
+         } else {
+            rehash(s);
+         }
+      }
+      return; 
+   }
+
+   /*resize arr if too full, or just sweep out tombstones
+     when they make up most of the load                  */
    if ( ELEMENT_RATIO > LOAD_FACTOR ){
-      resize(s);
+      if ( PAR_REHASH ){
+         par_rehash(s, !(TOMB_HEAVY));
+         return;
+      }
+      if ( !(TOMB_HEAVY) ){
+         resize(s);
+      }
       rehash(s); 
    } 
+}
 
-   insert_word(s, v); 
+static unsigned long place_word(hsh_dic* s, char* v, bool* added)
+{
+   /*full caches make room by evicting, everything else just adds*/
+   if ( IS_CACHE && s->num_elem >= s->max_elem ){
+      return cache_word(s, v, added);
+   }
+   return insert_word(s, v, added);
 }
 
-void rehash(dic* s)
+static unsigned long cache_word(hsh_dic* s, char* v, bool* added)
+{
+   /*Full cache. If v is missing, the first CACHE_WAYS slots of its
+     own probe chain are its set, and an unreferenced word there is
+     overwritten in place. Chains through that slot stay unbroken,
+     so nothing moves. Otherwise the clock hand evicts elsewhere,
+     leaving a tombstone, and v goes in as usual                   */
+   unsigned long key = 0;
+   unsigned long step = 0;
+   unsigned long victim = 0;
+   bool found = false;
+   int n = 0;
+
+   hash(s, v, &key, &step);
+
+   while ( !is_empty(s, key) ){
+      if ( is_same(s, v, key) ){
+         touch(s, key);
+         if ( added != NULL ){
+            *added = false;
+         }
+         return key; 
+      }
+      if ( !found && n < CACHE_WAYS && is_live(s, key) ){
+         n++;
+         if ( !s->ref[key] ){
+            victim = key;
+            found = true;
+         }
+      }
+      key = probe(s, key, step);
+   }
+
+   if ( !found ){
+      clock_evict(s);
+      return insert_word(s, v, added);
+   }
+
+   /*reuse the victim's buffer*/
+   memset(s->arr[victim], 0, s->max_str);
+   strncpy(s->arr[victim], v, s->max_str - 1); 
+   if ( s->vals != NULL ){
+      memset(&s->vals[victim], 0, sizeof(dic_val)); 
+   }
+   s->ref[victim] = 1;
+   s->num_evict++;
+   if ( added != NULL ){
+      *added = true;
+   }
+   return victim; 
+}
+
+static void clock_evict(hsh_dic* s)
+{
+   /*sweep the hand, giving referenced words a second chance*/
+   while ( true ){
+      if ( is_live(s, s->hand) ){
+         if ( s->ref[s->hand] ){
+            s->ref[s->hand] = 0;
+         } else {
+            free_str(s, s->arr[s->hand]);
+            s->arr[s->hand] = TOMB;
+            s->num_elem--;
+            s->num_tomb++;
+            s->num_evict++;
+            s->hand = (s->hand + 1) % s->arr_len;
+            return; 
+         }
+      }
+      s->hand = (s->hand + 1) % s->arr_len;
+   }
+}
+
+static void touch(hsh_dic* s, unsigned long key)
+{
+   if ( IS_CACHE ){
+      s->ref[key] = 1;
+   }
+}
+
+static void init_vals(hsh_dic* s)
+{
+   /*sets pay nothing for values until the first put*/
+   if ( IS_COMPACT ){
+      s->vals = (dic_val*) calloc(s->ent_cap, sizeof(dic_val));
+      if ( s->vals == NULL ){
+         ON_ERROR("Creation of Value Array Failed\n");
+      }
+      return;
+   }
+   if ( IS_HUGE ){
+      s->vals = (dic_val*) big_alloc(s, (size_t) s->arr_len * sizeof(dic_val),
+                                     &s->vals_map);
+      return;
+   }
+   s->vals = (dic_val*) calloc(s->arr_len, sizeof(dic_val));
+   if ( s->vals == NULL ){
+      ON_ERROR("Creation of Value Array Failed\n");
+   }
+}
+
+static void rehash(hsh_dic* s)
 {
    int i = 0, j = 0; 
    int old_size = s->arr_len;
    char** temp_arr = NULL; 
+   dic_val* temp_vals = NULL;
+   unsigned char* temp_ref = NULL;
+   unsigned long key;
+   double start = now_secs();
 
    temp_arr = init_arr(temp_arr, s->arr_len); 
+   if ( s->vals != NULL ){
+      temp_vals = (dic_val*) calloc(s->arr_len, sizeof(dic_val));
+      if ( temp_vals == NULL ){
+         ON_ERROR("Creation of Value Array Failed\n");
+      }
+   }
+
+   if ( IS_CACHE ){
+      temp_ref = (unsigned char*) calloc(s->arr_len, sizeof(unsigned char));
+      if ( temp_ref == NULL ){
+         ON_ERROR("Creation of Reference Array Failed\n");
+      }
+   }
 
    /*fill temp array*/
    for ( i = 0; i < old_size; i++){
-      arr_add_word(temp_arr, s, i, &j); 
+      if ( temp_ref != NULL && is_live(s, i) ){
+         temp_ref[j] = s->ref[i];
+      }
+      arr_add_word(temp_arr, temp_vals, s, i, &j); 
    }
 
    /*set s to empty*/
    for (i = 0; i < s->arr_len; i++){
 
       if (s->arr[i] != NULL){
-         free(s->arr[i]); 
+         free_str(s, s->arr[i]); 
       }
    }
 
+   s->num_elem = 0;
+   s->num_tomb = 0;
+
    /*re-hash to s*/
-   for( i = 0; i < s->arr_len; i++){
-      insert_word(s, temp_arr[i]); 
+   for( i = 0; i < j; i++){
+      key = insert_word(s, temp_arr[i], NULL); 
+      if ( temp_vals != NULL ){
+         s->vals[key] = temp_vals[i];
+      }
+      if ( temp_ref != NULL ){
+         s->ref[key] = temp_ref[i];
+      }
       free(temp_arr[i]); 
    }
 
    free(temp_arr); 
+   free(temp_vals); 
+   free(temp_ref); 
+
+   s->num_rehash++;
+   s->rehash_secs += now_secs() - start;
 }
 
-void arr_add_word(char** temp_arr, dic* s, int i, int* arr_ind)
+static void par_rehash(hsh_dic* s, bool grow)
+{
+   /*builds the new slot array from the old one in place of resize
+     and rehash: threads each take a range of old slots and move the
+     word pointers (values and ref bytes with them) to the new one */
+   struct _rehash_job jobs[MAX_THREADS];
+   pthread_t tids[MAX_THREADS];
+   bool started[MAX_THREADS];
+   char** old_arr = s->arr;
+   dic_val* old_vals = s->vals;
+   unsigned char* old_ref = s->ref;
+   size_t old_arr_map = s->arr_map, old_vals_map = s->vals_map;
+   int old_len = s->arr_len;
+   int i, n = s->threads;
+   double start = now_secs();
+
+   if ( grow ){
+      s->arr_len = prime_gen(old_len * ARR_INCREASE);
+      s->num_resize++;
+   }
+
+   if ( IS_HUGE ){
+      s->arr = (char**) big_alloc(s, (size_t) s->arr_len * sizeof(char*),
+                                  &s->arr_map);
+   } else {
+      s->arr = init_arr(NULL, s->arr_len);
+   }
+   if ( old_vals != NULL ){
+      init_vals(s);
+   }
+   if ( old_ref != NULL ){
+      s->ref = (unsigned char*) calloc(s->arr_len, sizeof(unsigned char));
+      if ( s->ref == NULL ){
+         ON_ERROR("Creation of Reference Array Failed\n");
+      }
+   }
+
+   for (i = 0; i < n; i++){
+      jobs[i].s = s;
+      jobs[i].old_arr = old_arr;
+      jobs[i].old_vals = old_vals;
+      jobs[i].old_ref = old_ref;
+      jobs[i].lo = (int) ((long) old_len * i / n);
+      jobs[i].hi = (int) ((long) old_len * (i + 1) / n);
+      /*the last share runs here; a thread that won't start too*/
+      started[i] = i < n - 1 &&
+                   pthread_create(&tids[i], NULL, rehash_worker, &jobs[i]) == 0;
+      if ( !started[i] ){
+         rehash_worker(&jobs[i]);
+      }
+   }
+   for (i = 0; i < n; i++){
+      if ( started[i] ){
+         pthread_join(tids[i], NULL);
+      }
+   }
+
+   /*tombstones were left behind, the words now live in s->arr*/
+   if ( IS_HUGE ){
+      big_free(old_arr, old_arr_map);
+      big_free(old_vals, old_vals_map);
+   } else {
+      free(old_arr);
+      free(old_vals);
+   }
+   free(old_ref);
+   s->num_tomb = 0;
+   s->hand = 0;
+
+   s->num_rehash++;
+   s->rehash_secs += now_secs() - start;
+}
+
+static void* rehash_worker(void* arg)
+{
+   struct _rehash_job* job = (struct _rehash_job*) arg;
+   hsh_dic* s = job->s;
+   unsigned long key, step;
+   char* word;
+   char* empty;
+   int i;
+
+   for (i = job->lo; i < job->hi; i++){
+      word = job->old_arr[i];
+      if ( word == NULL || word == TOMB ){
+         continue;
+      }
+
+      /*claim the first empty slot on word's probe path; the new
+        array has no tombstones and no duplicates to look for   */
+      hash(s, word, &key, &step);
+      empty = NULL;
+      while ( !__atomic_compare_exchange_n(&s->arr[key], &empty, word, false,
+                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED) ){
+         empty = NULL;
+         key = probe(s, key, step);
+      }
+
+      if ( job->old_vals != NULL ){
+         s->vals[key] = job->old_vals[i];
+      }
+      if ( job->old_ref != NULL ){
+         s->ref[key] = job->old_ref[i];
+      }
+   }
+   return NULL;
+}
+
+static void arr_add_word(char** temp_arr, dic_val* temp_vals, hsh_dic* s, int i, int* arr_ind)
 {
    int j = *arr_ind;
 
@@ -143,22 +701,26 @@ void arr_add_word(char** temp_arr, dic* s, int i, int* arr_ind)
       ON_ERROR("\nArr_add_word() passed a null value");
    }
 
-   if ( !is_empty(s, (unsigned long) i) ){
+   if ( is_live(s, (unsigned long) i) ){
 
       /*calloc space for word and copy it to array*/
       arr_init_str(temp_arr, j, s->max_str); 
-      strncpy(temp_arr[j++], s->arr[i], strlen(s->arr[i])); 
-
-      /*empty dictionary array*/ 
-      if (s->arr[i] != NULL){
-         s->arr[i] = NULL;
+      strncpy(temp_arr[j], s->arr[i], strlen(s->arr[i])); 
+      if ( temp_vals != NULL ){
+         temp_vals[j] = s->vals[i];
       }
+      j++;
+
+      free_str(s, s->arr[i]); 
    }
 
+   /*empty dictionary array*/ 
+   s->arr[i] = NULL;
+
    *arr_ind = j; 
 }
 
-void arr_init_str(char** arr, unsigned long index, int max_string)
+static void arr_init_str(char** arr, unsigned long index, int max_string)
 {
    /*get space for word*/
    arr[index] = (char*) calloc(max_string,sizeof(char));
@@ -167,7 +729,7 @@ void arr_init_str(char** arr, unsigned long index, int max_string)
    }
 }
 
-char** init_arr(char** arr, int len)
+static char** init_arr(char** arr, int len)
 {
    arr = (char**) calloc(len,sizeof(char*));
    if (arr == NULL){
@@ -177,10 +739,10 @@ char** init_arr(char** arr, int len)
 }
 
 /* Returns true if v is in the array, false elsewise */
-bool dic_isin(dic* s, char* v)
+bool hsh_isin(hsh_dic* s, char* v)
 {
    unsigned long key = 0;
-   unsigned long count = 0;   
+   unsigned long step = 0;
 
    if ( s == NULL || v == NULL){
       ON_ERROR("\nDic_isin() passed NULL value"); 
@@ -190,25 +752,120 @@ bool dic_isin(dic* s, char* v)
       return false; 
    }
 
-   key = hash(s, v, count); 
+   if ( IS_COMPACT ){
+      return compact_find(s, v, NULL, NULL) >= 0;
+   }
+
+   hash(s, v, &key, &step);
 
    while ( !is_empty(s, key) ){
 
          if ( is_same(s, v, key) ){
+         touch(s, key);
          return true; 
       }
       /*is there a collision?*/
-      ++count;
-      key = hash(s, v, count); 
+      key = probe(s, key, step);
    }
    return false; 
 }
 
+static long find_word(hsh_dic* s, char* v)
+{
+   /*slot holding v, or -1*/
+   unsigned long key = 0;
+   unsigned long step = 0;
+
+   if ( strlen(v) < 1 ){
+      return -1; 
+   }
+
+   hash(s, v, &key, &step);
+
+   while ( !is_empty(s, key) ){
+      if ( is_same(s, v, key) ){
+         return (long) key; 
+      }
+      key = probe(s, key, step);
+   }
+   return -1; 
+}
+
+/* Removes v, returns true if it was in the dic */
+bool hsh_remove(hsh_dic* s, char* v)
+{
+   unsigned long key = 0;
+   unsigned long step = 0;
+
+   if ( s == NULL || v == NULL ){
+      ON_ERROR("\nHsh_remove() passed NULL value");
+   }
+
+   if ( strlen(v) < 1 ){
+      return false;
+   }
+
+   if ( IS_COMPACT ){
+      return compact_remove(s, v);
+   }
+
+   hash(s, v, &key, &step);
+
+   while ( !is_empty(s, key) ){
+
+      if ( is_same(s, v, key) ){
+         free_str(s, s->arr[key]);
+         s->arr[key] = TOMB;
+         s->num_elem--;
+         s->num_tomb++;
+         return true;
+      }
+      key = probe(s, key, step);
+   }
+   return false;
+}
+
+/* Calls f on every word in the dic (slot order, or insertion
+   order for compact dics) */
+void hsh_foreach(hsh_dic* s, void (*f)(char* v, void* arg), void* arg)
+{
+   int i = 0;
+
+   if ( s == NULL || f == NULL ){
+      return;
+   }
+
+   if ( IS_COMPACT ){
+      for (i = 0; i < s->ent_len; i++){
+         if ( ent_word(s, i)[0] != '\0' ){
+            f(ent_word(s, i), arg);
+         }
+      }
+      return;
+   }
+
+   for (i = 0; i < s->arr_len; i++){
+      if ( is_live(s, i) ){
+         f(s->arr[i], arg);
+      }
+   }
+}
+
+/* Number of words in the dic, O(1) */
+int hsh_size(hsh_dic* s)
+{
+   if ( s == NULL ){
+      return 0; 
+   }
+   return s->num_elem; 
+}
+
 /* Clears all space used, and sets pointer to NULL */
-void dic_free(dic** s)
+void hsh_free(hsh_dic** s)
 {
    int i = 0; 
-   dic* p_d = NULL;
+   hsh_dic* p_d = NULL;
+   struct _arena_chunk* chunk;
 
    if ( s == NULL ){
       ON_ERROR("\ndic_free() passed a NULL value"); 
@@ -219,66 +876,552 @@ void dic_free(dic** s)
       return; 
    }
 
+   if ( p_d->ent_off != NULL ){
+      free(p_d->words);
+      free(p_d->ent_off);
+      free(p_d->ent_hash);
+      free(p_d->idx);
+      free(p_d->vals);
+      free(p_d);
+      *s = NULL;
+      return;
+   }
+
+   if ( p_d->huge ){
+      /*words go with their chunks*/
+      while ( p_d->arena->chunks != NULL ){
+         chunk = p_d->arena->chunks;
+         p_d->arena->chunks = chunk->next;
+         big_free(chunk, chunk->len);
+      }
+      free(p_d->arena);
+      big_free(p_d->arr, p_d->arr_map);
+      big_free(p_d->vals, p_d->vals_map);
+      free(p_d->ref);
+      free(p_d);
+      *s = NULL;
+      return;
+   }
+
    for (i = 0; i < p_d->arr_len; i++){
-      if ( p_d->arr[i] != NULL ){
+      if ( is_live(p_d, i) ){
          free(p_d->arr[i]); 
       }
    }
 
    free(p_d->arr); 
+   free(p_d->vals); 
+   free(p_d->ref); 
    free(p_d);    
-   p_d = NULL;
+   *s = NULL;
 }
 
-void insert_word(dic* s, char* v)
+static unsigned long insert_word(hsh_dic* s, char* v, bool* added)
 {
+   /*returns the slot holding v, added says if it is new*/
    unsigned long key = 0;
-   unsigned long count = 0;  
+   unsigned long step = 0;
+   unsigned long tomb_key = 0;
+   bool found_tomb = false;
 
    if ( s == NULL || v == NULL ){
       ON_ERROR("Insert_word() passed null value");
    }
 
-   key = hash(s, v, count); 
+   hash(s, v, &key, &step);
 
    while ( !is_empty(s, key) ){
 
       if ( is_same(s, v, key) ){
-         return; 
+         if ( added != NULL ){
+            *added = false;
+         }
+         return key; 
       }   
+      /*remember first tombstone, but keep probing for a duplicate*/
+      if ( !found_tomb && s->arr[key] == TOMB ){
+         tomb_key = key;
+         found_tomb = true;
+      }
       /*is there a collision?*/
-      count++;
-      key = hash(s, v, count);
+      key = probe(s, key, step);
+   }
+
+   if ( found_tomb ){
+      s->arr[tomb_key] = NULL;
+      s->num_tomb--;
+      key = tomb_key;
    }
 
    add_word(s, v, key); 
+   if ( added != NULL ){
+      *added = true;
+   }
+   return key; 
 }
 
-void add_word(dic* s, char* v, unsigned long index)
+static void add_word(hsh_dic* s, char* v, unsigned long index)
 {
    /*set pointer to space, copy word*/
    if (s->arr[index] == NULL){
       s->arr[index] = init_str(s, index); 
    }   
-   strncpy(s->arr[index], v, s->max_str); 
+   strncpy(s->arr[index], v, s->max_str - 1); 
+   if (s->vals != NULL){
+      memset(&s->vals[index], 0, sizeof(dic_val)); 
+   }
+   touch(s, index);
    s->num_elem++;
 }
 
-char* init_str(dic* s, unsigned long index)
+static char* init_str(hsh_dic* s, unsigned long index)
 {
    /*get space for word*/
-   s->arr[index] = (char*) calloc(s->max_str,sizeof(char));
-   if (s->arr[index] == NULL){  
-      ON_ERROR("Insert_word() Failed to calloc space for word");
-   }
+   s->arr[index] = alloc_str(s);
    return s->arr[index]; 
 }
 
-void resize(dic* s)
+static char* alloc_str(hsh_dic* s)
+{
+   struct _hsh_arena* a = s->arena;
+   struct _arena_chunk* chunk;
+   char* str;
+
+   if ( a == NULL ){
+      str = (char*) calloc(s->max_str, sizeof(char));
+      if (str == NULL){  
+         ON_ERROR("Insert_word() Failed to calloc space for word");
+      }
+      return str;
+   }
+
+   if ( a->free != NULL ){
+      str = a->free;
+      memcpy(&a->free, str, sizeof(char*));
+      memset(str, 0, a->slot);
+      return str;
+   }
+
+   if ( a->next == NULL || (size_t) (a->end - a->next) < a->slot ){
+      /*fresh mapping is zeroed, so new slots need no memset*/
+      chunk = (struct _arena_chunk*) big_alloc(s, a->grow, &a->grow);
+      chunk->len = a->grow;
+      chunk->next = a->chunks;
+      a->chunks = chunk;
+      a->mapped += chunk->len;
+      a->next = (char*) (chunk + 1);
+      a->end = (char*) chunk + chunk->len;
+      if ( a->grow < ARENA_MAX ){
+         a->grow *= 2;
+      }
+   }
+
+   str = a->next;
+   a->next += a->slot;
+   return str;
+}
+
+static void free_str(hsh_dic* s, char* str)
+{
+   if ( s->arena == NULL ){
+      free(str);
+      return;
+   }
+   memcpy(str, &s->arena->free, sizeof(char*));
+   s->arena->free = str;
+}
+
+static void* big_alloc(hsh_dic* s, size_t bytes, size_t* mapped)
+{
+   /*anonymous mapping (zeroed), huge pages and NUMA policy per s->huge*/
+   void* p = MAP_FAILED;
+   size_t len = (bytes + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+   unsigned long mask = s->nodemask;
+   int mode = 0;
+
+#ifdef MAP_HUGETLB
+   if ( s->huge & HSH_HUGE_EXPLICIT ){
+      p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if ( p == MAP_FAILED ){
+         s->num_huge_fallback++;
+      }
+   }
+#endif
+   if ( p == MAP_FAILED ){
+      p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if ( p == MAP_FAILED ){
+         ON_ERROR("Huge page mapping failed\n");
+      }
+#ifdef MADV_HUGEPAGE
+      if ( s->huge & (HSH_HUGE_THP | HSH_HUGE_EXPLICIT) ){
+         madvise(p, len, MADV_HUGEPAGE);
+      }
+#endif
+   }
+
+   /*policy before first touch, so pages fault in on the right nodes*/
+   if ( s->huge & HSH_NUMA_INTERLEAVE ){
+      mode = MPOL_INTERLEAVE;
+   } else if ( s->huge & HSH_NUMA_BIND ){
+      mode = MPOL_BIND;
+   }
+#ifdef SYS_mbind
+   if ( mode != 0 ){
+      syscall(SYS_mbind, p, len, mode, &mask, sizeof(mask) * 8, 0);
+   }
+#else
+   (void) mask;
+#endif
+
+   *mapped = len;
+   return p;
+}
+
+static void* grow_mapping(hsh_dic* s, void* old, size_t width, int new_len,
+                          size_t* mapped)
+{
+   void* p;
+   size_t old_map = *mapped;
+
+   if ( (size_t) new_len * width <= old_map ){
+      return old;
+   }
+   p = big_alloc(s, (size_t) new_len * width, mapped);
+   memcpy(p, old, (size_t) s->arr_len * width);
+   big_free(old, old_map);
+   return p;
+}
+
+static void big_free(void* p, size_t mapped)
+{
+   if ( p != NULL ){
+      munmap(p, mapped);
+   }
+}
+
+static unsigned long online_nodes(void)
+{
+   /*parse e.g. "0-1,3"; one node when sysfs won't say*/
+   FILE* fp = fopen("/sys/devices/system/node/online", "r");
+   unsigned long mask = 0;
+   int lo, hi;
+   char sep;
+
+   if ( fp == NULL ){
+      return 1;
+   }
+   while ( fscanf(fp, "%d", &lo) == 1 ){
+      hi = lo;
+      if ( fscanf(fp, "%c", &sep) == 1 && sep == '-' ){
+         if ( fscanf(fp, "%d", &hi) != 1 ){
+            break;
+         }
+         if ( fscanf(fp, "%c", &sep) != 1 ){
+            sep = '\n';
+         }
+      }
+      for ( ; lo <= hi && lo < (int) sizeof(mask) * 8; lo++){
+         mask |= 1UL << lo;
+      }
+      if ( sep != ',' ){
+         break;
+      }
+   }
+   fclose(fp);
+
+   return mask ? mask : 1;
+}
+
+static void compact_layout(hsh_dic* s)
+{
+   /*a fresh, empty index for arr_len slots, as narrow as the
+     largest entry number allows                             */
+   unsigned long top = (unsigned long) ent_max(s) + 2;
+
+   s->idx_width = top <= UINT8_MAX ? 1 : top <= UINT16_MAX ? 2 : 4;
+   free(s->idx);
+   s->idx = calloc(s->arr_len, s->idx_width);
+   if ( s->idx == NULL ){
+      ON_ERROR("Creation of Compact Index Failed\n");
+   }
+}
+
+static long compact_find(hsh_dic* s, char* v, unsigned long* slot, int* probes)
+{
+   /*entry holding v, or -1; slot gets where the probe stopped*/
+   uint64_t h = word_hash(s, v);
+   unsigned long key, step, e;
+   int len = 1;
+
+   split_hash(s, h, &key, &step);
+
+   while ( (e = idx_get(s, key)) != IDX_EMPTY ){
+      if ( e != IDX_DUMMY && s->ent_hash[e - 2] == h &&
+           strncmp(ent_word(s, e - 2), v, s->max_str - 1) == 0 ){
+         break;
+      }
+      key = probe(s, key, step);
+      len++;
+   }
+
+   if ( slot != NULL ){
+      *slot = key;
+   }
+   if ( probes != NULL ){
+      *probes = len;
+   }
+   return e == IDX_EMPTY ? -1 : (long) e - 2;
+}
+
+static long compact_place(hsh_dic* s, char* v, bool* added)
+{
+   /*entry holding v, appending it if new*/
+   uint64_t h;
+   unsigned long key, step, e, dummy_key = 0;
+   bool found_dummy = false;
+   size_t len;
+   long n;
+
+   compact_room(s);
+
+   h = word_hash(s, v);
+   split_hash(s, h, &key, &step);
+
+   while ( (e = idx_get(s, key)) != IDX_EMPTY ){
+      if ( e == IDX_DUMMY ){
+         /*first removed slot is reused, but keep looking for v*/
+         if ( !found_dummy ){
+            dummy_key = key;
+            found_dummy = true;
+         }
+      } else if ( s->ent_hash[e - 2] == h &&
+                  strncmp(ent_word(s, e - 2), v, s->max_str - 1) == 0 ){
+         if ( added != NULL ){
+            *added = false;
+         }
+         return (long) e - 2;
+      }
+      key = probe(s, key, step);
+   }
+
+   if ( found_dummy ){
+      key = dummy_key;
+      s->num_tomb--;
+   }
+
+   len = strlen(v);
+   if ( len > (size_t) s->max_str - 1 ){
+      len = s->max_str - 1;
+   }
+   grow_words(s, len + 1);
+
+   n = s->ent_len++;
+   s->ent_off[n] = (uint32_t) s->words_len;
+   memcpy(ent_word(s, n), v, len);
+   ent_word(s, n)[len] = '\0';
+   s->words_len += len + 1;
+   s->ent_hash[n] = h;
+   if ( s->vals != NULL ){
+      memset(&s->vals[n], 0, sizeof(dic_val));
+   }
+   idx_set(s, key, (unsigned long) n + 2);
+   s->num_elem++;
+
+   if ( added != NULL ){
+      *added = true;
+   }
+   return n;
+}
+
+static bool compact_remove(hsh_dic* s, char* v)
+{
+   /*the slot becomes a dummy, the entry an empty word until
+     the next rebuild squeezes it out                        */
+   unsigned long key;
+   long e = compact_find(s, v, &key, NULL);
+
+   if ( e < 0 ){
+      return false;
+   }
+
+   idx_set(s, key, IDX_DUMMY);
+   ent_word(s, e)[0] = '\0';
+   s->num_elem--;
+   s->num_tomb++;
+   return true;
+}
+
+static void compact_room(hsh_dic* s)
+{
+   /*the index stays under LOAD_FACTOR as long as entries do, so
+     only a full entry array needs work: squeeze out removed
+     entries when they are a quarter of it, else double the array,
+     and only past LOAD_FACTOR grow and rebuild the index         */
+   int cap;
+
+   if ( s->ent_len < s->ent_cap ){
+      return;
+   }
+
+   if ( (s->ent_len - s->num_elem) * 4 >= s->ent_len ){
+      compact_rebuild(s, s->arr_len);
+   } else if ( s->ent_cap >= ent_max(s) ){
+      s->num_resize++;
+      compact_rebuild(s, prime_gen(s->arr_len * IDX_INCREASE));
+   }
+
+   if ( s->ent_len == s->ent_cap ){
+      cap = s->ent_cap * 2;
+      grow_ents(s, cap < ent_max(s) ? cap : ent_max(s));
+   }
+}
+
+static void compact_rebuild(hsh_dic* s, int new_len)
+{
+   /*drop removed entries and their words (order kept, so words
+     only move down), then re-slot the rest from their stored
+     hashes: no words hashed or compared                        */
+   unsigned long key, step;
+   int i, j = 0;
+   size_t len, off = 0;
+   double start = now_secs();
+
+   for (i = 0; i < s->ent_len; i++){
+      if ( ent_word(s, i)[0] == '\0' ){
+         continue;
+      }
+      len = strlen(ent_word(s, i)) + 1;
+      memmove(s->words + off, ent_word(s, i), len);
+      s->ent_off[j] = (uint32_t) off;
+      s->ent_hash[j] = s->ent_hash[i];
+      if ( s->vals != NULL ){
+         s->vals[j] = s->vals[i];
+      }
+      off += len;
+      j++;
+   }
+   s->ent_len = j;
+   s->words_len = off;
+   s->num_tomb = 0;
+
+   if ( new_len != s->arr_len ){
+      s->arr_len = new_len;
+      compact_layout(s);
+   } else {
+      memset(s->idx, 0, (size_t) s->arr_len * s->idx_width);
+   }
+
+   for (i = 0; i < s->ent_len; i++){
+      split_hash(s, s->ent_hash[i], &key, &step);
+      while ( idx_get(s, key) != IDX_EMPTY ){
+         key = probe(s, key, step);
+      }
+      idx_set(s, key, (unsigned long) i + 2);
+   }
+
+   s->num_rehash++;
+   s->rehash_secs += now_secs() - start;
+}
+
+static void grow_ents(hsh_dic* s, int cap)
+{
+   uint32_t* offs;
+   uint64_t* hashes;
+   dic_val* vals;
+
+   offs = (uint32_t*) realloc(s->ent_off, (size_t) cap * sizeof(uint32_t));
+   hashes = (uint64_t*) realloc(s->ent_hash, (size_t) cap * sizeof(uint64_t));
+   if ( offs == NULL || hashes == NULL ){
+      ON_ERROR("\nEntry array realloc failed");
+   }
+   s->ent_off = offs;
+   s->ent_hash = hashes;
+
+   if ( s->vals != NULL ){
+      vals = (dic_val*) realloc(s->vals, (size_t) cap * sizeof(dic_val));
+      if ( vals == NULL ){
+         ON_ERROR("\nValue array realloc failed");
+      }
+      s->vals = vals;
+   }
+   s->ent_cap = cap;
+}
+
+static void grow_words(hsh_dic* s, size_t need)
+{
+   /*room for need more bytes of words, doubling*/
+   size_t cap = s->words_cap ? s->words_cap : (size_t) ENT_START * 8;
+   char* words;
+
+   if ( s->words_len + need <= s->words_cap ){
+      return;
+   }
+   while ( cap < s->words_len + need ){
+      cap *= 2;
+   }
+   if ( cap > UINT32_MAX ){
+      /*offsets are 32 bit*/
+      if ( s->words_len + need > UINT32_MAX ){
+         ON_ERROR("\nCompact dic words past 4GB");
+      }
+      cap = UINT32_MAX;
+   }
+
+   words = (char*) realloc(s->words, cap);
+   if ( words == NULL ){
+      ON_ERROR("\nWord array realloc failed");
+   }
+   s->words = words;
+   s->words_cap = cap;
+}
+
+static int ent_max(hsh_dic* s)
+{
+   /*entries allowed before the index must grow*/
+   int max = (int) (s->arr_len * LOAD_FACTOR);
+
+   return max > 0 ? max : 1;
+}
+
+static char* ent_word(hsh_dic* s, long e)
+{
+   return s->words + s->ent_off[e];
+}
+
+static unsigned long idx_get(hsh_dic* s, unsigned long slot)
+{
+   switch ( s->idx_width ){
+      case 1:
+         return ((uint8_t*) s->idx)[slot];
+      case 2:
+         return ((uint16_t*) s->idx)[slot];
+      default:
+         return ((uint32_t*) s->idx)[slot];
+   }
+}
+
+static void idx_set(hsh_dic* s, unsigned long slot, unsigned long e)
+{
+   switch ( s->idx_width ){
+      case 1:
+         ((uint8_t*) s->idx)[slot] = (uint8_t) e;
+         break;
+      case 2:
+         ((uint16_t*) s->idx)[slot] = (uint16_t) e;
+         break;
+      default:
+         ((uint32_t*) s->idx)[slot] = (uint32_t) e;
+   }
+}
+
+static void resize(hsh_dic* s)
 {
    /*increase array size and increment until next nearest prime num*/
    int new_size;
    char** temp;
+   dic_val* vals;
    int i; 
 
    if (s == NULL){
@@ -286,17 +1429,36 @@ void resize(dic* s)
    }
  
    new_size = prime_gen(s->arr_len * ARR_INCREASE);
-
-   /*realloc space*/
-   temp = (char**) realloc(s->arr,sizeof(char*) * new_size);
+   s->num_resize++;
+
+   /*realloc space; huge dics map a new array, or grow in place
+     when the rounded up mapping already has room*/
+   if ( IS_HUGE ){
+      temp = grow_mapping(s, s->arr, sizeof(char*), new_size, &s->arr_map);
+   } else {
+      temp = (char**) realloc(s->arr,sizeof(char*) * new_size);
+   }
 
    if (temp == NULL){
-      dic_free(&s); 
+      hsh_free(&s); 
       ON_ERROR("\nRealloc failed");
    }
  
    s->arr = temp; 
 
+   /*values keep their old slots until rehash moves them*/
+   if (s->vals != NULL){
+      if ( IS_HUGE ){
+         vals = grow_mapping(s, s->vals, sizeof(dic_val), new_size, &s->vals_map);
+      } else {
+         vals = (dic_val*) realloc(s->vals, sizeof(dic_val) * new_size);
+      }
+      if (vals == NULL){
+         ON_ERROR("\nValue array realloc failed");
+      }
+      s->vals = vals; 
+   }
+
    /*initialize all new realloced values*/
    for (i = s->arr_len; i < new_size; i++){
       s->arr[i] = NULL; 
@@ -305,67 +1467,341 @@ void resize(dic* s)
    s->arr_len = new_size;
 
    if (s->arr == NULL){
-      dic_free(&s); 
+      hsh_free(&s); 
       ON_ERROR("\nResized array...dictionary arr points to NULL");
    }
 }
 
-unsigned long hash(dic* s, char* str, unsigned long count)
+static void hash(hsh_dic* s, char* str, unsigned long* key, unsigned long* step)
 {
-   /*If no collision:     key = h1 
-     For every collision, collision count incremented
-     and multiplied by h2 thus: 
+   /*One pass of the table's hash gives both probe values:
+     If no collision:     key = h1 
+     For every collision, step (h2) is added again thus: 
                           key = h1 + (h2 * collision count) 
-     to avoid clustering                                  */
-   unsigned long h1 = hash1(str, HASH_SEED);
-   unsigned long h2 = hash2(str);
-   unsigned long k = h1 + count*h2;
-   return (unsigned long) k % s->arr_len;  
+     to avoid clustering. h2 comes from the high half, is never
+     0 and, arr_len being prime, visits every slot            */
+   split_hash(s, word_hash(s, str), key, step);
 }
 
-unsigned long hash1(char* str, int seed)
+static uint64_t word_hash(hsh_dic* s, char* str)
 {
-   /*djb2 hash*/
-   unsigned long hash = seed;
-   int c; 
+   size_t len = strlen(str);
 
-   while ( (c = *str++) ){
-      hash = ((hash << 5) + hash) + c;
+   /*words are stored cut to max_str - 1, hash the same bytes*/
+   if ( len > (size_t) s->max_str - 1 ){
+      len = s->max_str - 1;
    }
+   return s->hash(str, len, s->seed);
+}
 
-   return hash; 
+static void split_hash(hsh_dic* s, uint64_t h, unsigned long* key,
+                       unsigned long* step)
+{
+   *key = (unsigned long) (h % (uint64_t) s->arr_len);
+   *step = 1 + (unsigned long) ((h >> 32) % (uint64_t) (s->arr_len - 1));
+}
+
+static unsigned long probe(hsh_dic* s, unsigned long key, unsigned long step)
+{
+   /*next slot after a collision*/
+   key += step;
+   if ( key >= (unsigned long) s->arr_len ){
+      key -= s->arr_len;
+   }
+   return key;
 }
 
-unsigned long hash2(char* str){
-   /*for probing after collision */
-   unsigned long h = 0; 
-   unsigned int i; 
+uint64_t hsh_siphash(const char* str, size_t len, const uint64_t seed[2])
+{
+   /*SipHash-1-3: keyed, 8 bytes per round, so a random seed
+     per table stops anyone precomputing colliding words     */
+   const unsigned char* p = (const unsigned char*) str;
+   uint64_t v0 = SIP_C0 ^ seed[0];
+   uint64_t v1 = SIP_C1 ^ seed[1];
+   uint64_t v2 = SIP_C2 ^ seed[0];
+   uint64_t v3 = SIP_C3 ^ seed[1];
+   uint64_t b = (uint64_t) len << 56;
+   uint64_t m;
+   int i;
+
+   for ( ; len >= 8; len -= 8, p += 8){
+      m = 0;
+      for (i = 0; i < 8; i++){
+         m |= (uint64_t) p[i] << (8 * i);
+      }
+      v3 ^= m;
+      SIPROUND;
+      v0 ^= m;
+   }
 
-   for (i = 0; i < strlen(str); i++){
-      h += (unsigned long) str[i]; 
+   /*last 0-7 bytes, little endian*/
+   for (i = 0; i < (int) len; i++){
+      b |= (uint64_t) p[i] << (8 * i);
    }
-   /*never returns 0*/
-   return PRIME - (h % PRIME);
+   v3 ^= b;
+   SIPROUND;
+   v0 ^= b;
+
+   v2 ^= 0xff;
+   SIPROUND;
+   SIPROUND;
+   SIPROUND;
+
+   return v0 ^ v1 ^ v2 ^ v3;
 }
 
-bool is_same(dic* s, char* v, unsigned long key)
+uint64_t hsh_djb2(const char* str, size_t len, const uint64_t seed[2])
+{
+   /*the original djb2, byte at a time, seed folded into the start*/
+   uint64_t hash = HASH_SEED ^ seed[0];
+   size_t i;
+
+   for (i = 0; i < len; i++){
+      hash = ((hash << 5) + hash) + (unsigned char) str[i];
+   }
+
+   /*spread the low bits into the high half used for the step*/
+   return hash ^ ((hash * 0x9e3779b97f4a7c15ULL) & 0xffffffff00000000ULL);
+}
+
+/* Swaps the hash function and seed, re-placing every word */
+void hsh_set_hash(hsh_dic* s, hsh_hash_fn fn, const uint64_t seed[2])
+{
+   int i;
+
+   if ( s == NULL || fn == NULL ){
+      ON_ERROR("\nHsh_set_hash() passed a NULL value");
+   }
+
+   s->hash = fn;
+   if ( seed != NULL ){
+      s->seed[0] = seed[0];
+      s->seed[1] = seed[1];
+   } else {
+      seed_table(s);
+   }
+
+   if ( IS_COMPACT ){
+      for (i = 0; i < s->ent_len; i++){
+         if ( ent_word(s, i)[0] != '\0' ){
+            s->ent_hash[i] = word_hash(s, ent_word(s, i));
+         }
+      }
+      compact_rebuild(s, s->arr_len);
+      return;
+   }
+
+   if ( PAR_REHASH ){
+      par_rehash(s, false);
+   } else if ( s->num_elem > 0 || s->num_tomb > 0 ){
+      rehash(s);
+   }
+}
+
+/*Rehash with up to threads workers (0: one per online CPU, 1: the
+  default serial rehash). Workers move word pointers into the new
+  slot array, claiming slots atomically: no word is copied        */
+void hsh_set_threads(hsh_dic* s, int threads)
+{
+   if ( s == NULL ){
+      ON_ERROR("\nHsh_set_threads() passed a NULL value");
+   }
+
+   if ( threads < 1 ){
+      threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+   }
+   if ( threads < 1 ){
+      threads = 1;
+   }
+   if ( threads > MAX_THREADS ){
+      threads = MAX_THREADS;
+   }
+   s->threads = threads;
+}
+
+/* Fills st with the shape of s: load, probe lengths, growth, bytes */
+void hsh_get_stats(hsh_dic* s, hsh_stats* st)
+{
+   int i, len, hits = 0, misses = 0;
+   unsigned long hit_total = 0, miss_total = 0;
+   char miss_word[MAXWORD];
+   char* word;
+   bool found;
+
+   if ( s == NULL || st == NULL ){
+      ON_ERROR("\nHsh_get_stats() passed a NULL value");
+   }
+
+   memset(st, 0, sizeof(hsh_stats));
+   st->num_elem = s->num_elem;
+   st->num_tomb = s->num_tomb;
+   st->arr_len = s->arr_len;
+   st->load = (double) s->num_elem / (double) s->arr_len;
+   st->num_resize = s->num_resize;
+   st->num_rehash = s->num_rehash;
+   st->rehash_secs = s->rehash_secs;
+   st->num_evict = s->num_evict;
+   st->slot_bytes = (size_t) s->arr_len * sizeof(char*);
+   if ( s->ref != NULL ){
+      st->slot_bytes += s->arr_len;
+   }
+   st->string_bytes = (size_t) s->num_elem * s->max_str;
+   if ( IS_COMPACT ){
+      st->slot_bytes = (size_t) s->arr_len * s->idx_width +
+                       (size_t) s->ent_cap * (sizeof(uint32_t) + sizeof(uint64_t));
+      st->string_bytes = s->words_cap;
+   }
+   if ( IS_HUGE ){
+      st->mapped_bytes = s->arr_map + s->vals_map + s->arena->mapped;
+      st->num_huge_fallback = s->num_huge_fallback;
+   }
+
+   /*successful lookups: re-probe every stored word*/
+   for (i = 0; i < (IS_COMPACT ? s->ent_len : s->arr_len); i++){
+      word = IS_COMPACT ? ent_word(s, i) : s->arr[i];
+      if ( IS_COMPACT ? word[0] != '\0' : is_live(s, i) ){
+         len = probe_len(s, word, &found);
+         add_probe(st->hit_probes, len);
+         hit_total += len;
+         hits++;
+         if ( len > st->longest_hit ){
+            st->longest_hit = len;
+         }
+      }
+   }
+
+   /*unsuccessful lookups: probe words that can't be stored
+     (a leading \x01), so start and step follow the real hash*/
+   for (i = 0; i < MISS_SAMPLES; i++){
+      sprintf(miss_word, "\x01%d", i);
+      len = probe_len(s, miss_word, &found);
+      if ( found ){
+         continue;
+      }
+      add_probe(st->miss_probes, len);
+      miss_total += len;
+      misses++;
+      if ( len > st->longest_miss ){
+         st->longest_miss = len;
+      }
+   }
+
+   st->avg_hit = hits ? (double) hit_total / hits : 0;
+   st->avg_miss = misses ? (double) miss_total / misses : 0;
+}
+
+/* Prints the stats from hsh_get_stats */
+void hsh_print_stats(hsh_stats* st)
+{
+   int i;
+
+   if ( st == NULL ){
+      return;
+   }
+
+   printf("\nelements %d, slots %d, tombstones %d, load %.3f",
+          st->num_elem, st->arr_len, st->num_tomb, st->load);
+   printf("\nprobes: hit avg %.2f max %d, miss avg %.2f max %d",
+          st->avg_hit, st->longest_hit, st->avg_miss, st->longest_miss);
+   printf("\nresizes %d, rehashes %d, %.3fs in rehash, evictions %lu",
+          st->num_resize, st->num_rehash, st->rehash_secs, st->num_evict);
+   printf("\nbytes: slots %lu, strings %lu",
+          (unsigned long) st->slot_bytes, (unsigned long) st->string_bytes);
+   if ( st->mapped_bytes > 0 ){
+      printf("\nhuge: mapped %lu, MAP_HUGETLB refused %lu",
+             (unsigned long) st->mapped_bytes, st->num_huge_fallback);
+   }
+   printf("\nprobe len     hits     misses");
+   for (i = 0; i < HSH_PROBE_HIST; i++){
+      printf("\n%s%-8d %8lu %10lu", i == HSH_PROBE_HIST - 1 ? ">=" : "  ",
+             i + 1, st->hit_probes[i], st->miss_probes[i]);
+   }
+   printf("\n");
+}
+
+static int probe_len(hsh_dic* s, char* v, bool* found)
+{
+   /*slots looked at before v is found, or an empty slot ends it*/
+   unsigned long key = 0;
+   unsigned long step = 0;
+   int len = 1;
+
+   if ( IS_COMPACT ){
+      *found = compact_find(s, v, NULL, &len) >= 0;
+      return len;
+   }
+
+   hash(s, v, &key, &step);
+
+   while ( !is_empty(s, key) ){
+      if ( is_same(s, v, key) ){
+         *found = true;
+         return len;
+      }
+      key = probe(s, key, step);
+      len++;
+   }
+   *found = false;
+   return len;
+}
+
+static void add_probe(unsigned long* hist, int len)
+{
+   /*last bucket collects every longer chain*/
+   if ( len > HSH_PROBE_HIST ){
+      len = HSH_PROBE_HIST;
+   }
+   hist[len - 1]++;
+}
+
+static double now_secs(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static void seed_table(hsh_dic* s)
+{
+   hsh_random_seed(s->seed);
+}
+
+/* Fills seed with fresh random bits for a keyed hash */
+void hsh_random_seed(uint64_t seed[2])
+{
+   /*falls back to clock, time and address bits
+     where /dev/urandom is missing              */
+   FILE* fp = fopen("/dev/urandom", "rb");
+
+   if ( fp == NULL || fread(seed, sizeof(uint64_t) * 2, 1, fp) != 1 ){
+      seed[0] = (uint64_t) time(NULL) ^ ((uint64_t) clock() << 32);
+      seed[1] = (uint64_t) (size_t) seed ^ ROTL(seed[0], 29);
+   }
+
+   if ( fp != NULL ){
+      fclose(fp);
+   }
+}
+
+static bool is_same(hsh_dic* s, char* v, unsigned long key)
 {
    /*returns true if word v matches word at given key*/
    if ( v == NULL ){
       ON_ERROR("\nIs_same() passed a Null string"); 
    }
 
-   if ( is_empty(s, key) ){
+   if ( !is_live(s, key) ){
       return false; 
    }
 
-   if ( strncmp(s->arr[key], v, s->max_str) == 0 ){ 
+   if ( strncmp(s->arr[key], v, s->max_str - 1) == 0 ){ 
       return true; 
    } 
    return false; 
 }
 
-bool is_empty(dic* s, unsigned long key)
+static bool is_empty(hsh_dic* s, unsigned long key)
 {
    if ((int) key >= s->arr_len || (int) key < 0){
       ON_ERROR("Is_empty() encountered index out of bounds");
@@ -378,15 +1814,13 @@ bool is_empty(dic* s, unsigned long key)
    return false;  
 }
 
-int max(int x, int y)
+static bool is_live(hsh_dic* s, unsigned long key)
 {
-   if (x > y) {
-      return x; 
-   } 
-   return y; 
+   /*holds a word: neither empty nor a tombstone*/
+   return !is_empty(s, key) && s->arr[key] != TOMB;
 }
 
-int prime_gen(int start_num)
+static int prime_gen(int start_num)
 {
    /*returns closest prime larger than start_num*/
    while ( !isprime(start_num) ){
@@ -395,7 +1829,7 @@ int prime_gen(int start_num)
    return start_num; 
 }
 
-bool isprime(int num)
+static bool isprime(int num)
 {
    int i = 0; 
       if (num <= 1){
@@ -409,7 +1843,7 @@ bool isprime(int num)
    return true;
 }
 
-void print_dic(dic* s)
+void hsh_print(hsh_dic* s)
 {
    int i = 0; 
    
@@ -417,8 +1851,17 @@ void print_dic(dic* s)
       return; 
    }
 
+   if ( IS_COMPACT ){
+      for (i = 0; i < s->ent_len; i++){
+         if ( ent_word(s, i)[0] != '\0' ){
+            printf("\n[%d] %s", i, ent_word(s, i));
+         }
+      }
+      return;
+   }
+
    for (i = 0; i < s->arr_len; i++){
-      if ( !is_empty(s, i) ){
+      if ( is_live(s, i) ){
          printf("\n[%d] %s", i, s->arr[i]);
       }
    }
@@ -1,31 +1,168 @@
 /*******************************
  *  Double Hashing Header File *
  *******************************/
+#ifndef HSH_H
+#define HSH_H
 
-#include <stdio.h>
-#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "dic.h"
 
-#define MAXWORD 50
-#define ON_ERROR(STR) fprintf(stderr, STR); exit(EXIT_FAILURE)
+/*hsh_init_huge flags*/
+#define HSH_HUGE_THP        1 /*madvise(MADV_HUGEPAGE), transparent*/
+#define HSH_HUGE_EXPLICIT   2 /*MAP_HUGETLB from the reserved pool, THP
+                                when the pool is empty               */
+#define HSH_NUMA_INTERLEAVE 4 /*pages round robin over nodemask*/
+#define HSH_NUMA_BIND       8 /*pages only on nodemask's nodes*/
 
-typedef enum _bool {false, true} bool;
+/*pluggable hash: one 64 bit value per word, low half picks the
+  first slot, high half the probe step                        */
+typedef uint64_t (*hsh_hash_fn)(const char* str, size_t len, const uint64_t seed[2]);
 
-struct _dic {
+struct _hsh_dic {
    char** arr; 
    int max_str;
    int num_elem;
+   int num_tomb;
    int arr_len; 
+   dic_val* vals;   /*one per slot, NULL until the first put*/
+   hsh_hash_fn hash;
+   uint64_t seed[2];
+   /*growth telemetry*/
+   int num_resize;
+   int num_rehash;
+   double rehash_secs;
+   int threads;     /*rehash workers, see hsh_set_threads*/
+   /*cache mode (ref NULL otherwise)*/
+   int max_elem;
+   unsigned char* ref; /*CLOCK reference byte per slot*/
+   int hand;
+   unsigned long num_evict;
+   /*huge page mode (flags 0 otherwise): arr and vals are their own
+     mappings, words come from an arena of mapped chunks           */
+   int huge;
+   unsigned long nodemask;
+   size_t arr_map;     /*bytes mapped for arr, and for vals*/
+   size_t vals_map;
+   struct _hsh_arena* arena;
+   unsigned long num_huge_fallback; /*MAP_HUGETLB refused*/
+   /*compact mode (ent_off NULL otherwise): arr is unused, entries
+     sit in insertion order and each idx slot holds entry + 2, 0
+     when empty and 1 when removed, in idx_width bytes            */
+   char* words;        /*entries' words back to back, with '\0's*/
+   size_t words_len;
+   size_t words_cap;
+   uint32_t* ent_off;  /*entry -> its word, "" once removed*/
+   uint64_t* ent_hash; /*so growth re-slots without rehashing*/
+   int ent_len;        /*entries used, removed ones included*/
+   int ent_cap;        /*doubles up to LOAD_FACTOR * arr_len*/
+   void* idx;
+   int idx_width;      /*1, 2 or 4*/
 };
-typedef struct _dic dic; 
+typedef struct _hsh_dic hsh_dic; 
+
+#define HSH_PROBE_HIST 16 /*probe lengths 1..15, then 16 or more*/
+
+struct _hsh_stats {
+   int num_elem;
+   int num_tomb;
+   int arr_len;
+   double load;
+   /*probe lengths: hits re-probe every word, misses a sample*/
+   unsigned long hit_probes[HSH_PROBE_HIST];
+   unsigned long miss_probes[HSH_PROBE_HIST];
+   double avg_hit;
+   double avg_miss;
+   int longest_hit;
+   int longest_miss;
+   /*growth*/
+   int num_resize;
+   int num_rehash;
+   double rehash_secs;
+   unsigned long num_evict;
+   /*memory*/
+   size_t slot_bytes;
+   size_t string_bytes;
+   size_t mapped_bytes;       /*huge dics: arr, vals and word chunks*/
+   unsigned long num_huge_fallback;
+};
+typedef struct _hsh_stats hsh_stats;
 
 /*Create empty dic*/
-dic* dic_init(int size); 
+hsh_dic* hsh_init(int size); 
+
+/*Create empty dic with at least len slots, for small dics*/
+hsh_dic* hsh_init_len(int size, int len);
+
+/*Create empty dic with at least len slots whose slot array and
+  word storage sit in huge pages (flags HSH_HUGE_*), optionally
+  placed by NUMA policy HSH_NUMA_* over nodemask (0: every node
+  online). Growth maps a new array rather than realloc'ing      */
+hsh_dic* hsh_init_huge(int size, int len, int flags, unsigned long nodemask);
+
+/*Create empty dic with at least len slots in the compact layout:
+  slots are 1 to 4 byte indices into a dense, insertion ordered
+  entry array (values are kept per entry). Growth only rebuilds
+  the index, foreach walks live entries in insertion order       */
+hsh_dic* hsh_init_compact(int size, int len);
+
+/*Rehash with up to threads workers (0: one per online CPU, 1: the
+  default serial rehash). Workers move word pointers into the new
+  slot array, claiming slots atomically: no word is copied        */
+void hsh_set_threads(hsh_dic* s, int threads);
+
+/*Create a bounded cache of at most max_elem words, or what fits in
+  max_bytes if non-zero. Full caches evict with CLOCK instead of growing*/
+hsh_dic* hsh_init_cache(int size, int max_elem, size_t max_bytes);
 
 /* Add one element into the dic */
-void dic_insert(dic* s, char* v);
+void hsh_insert(hsh_dic* s, char* v);
 
 /* Returns true if v is in the array, false elsewise */
-bool dic_isin(dic* s, char* v);
+bool hsh_isin(hsh_dic* s, char* v);
+
+/* Copies the value stored with v into out, returns false if v isn't in */
+bool hsh_get(hsh_dic* s, char* v, dic_val* out);
+
+/* Stores val with v, adding v if needed */
+void hsh_put(hsh_dic* s, char* v, dic_val val);
+
+/* Value slot for v, added (zeroed) if missing, in one probe.
+   Valid until the next insert, which may move the table */
+dic_val* hsh_slot(hsh_dic* s, char* v, bool* added);
+
+/* Removes v, returns true if it was in the dic */
+bool hsh_remove(hsh_dic* s, char* v);
+
+/* Calls f on every word in the dic (slot order) */
+void hsh_foreach(hsh_dic* s, void (*f)(char* v, void* arg), void* arg);
+
+/* Number of words in the dic, O(1) */
+int hsh_size(hsh_dic* s);
 
 /* Clears all space used, and sets pointer to NULL */
-void dic_free(dic** s);
+void hsh_free(hsh_dic** s);
+
+/* Swaps the hash function and seed (NULL for a fresh random one),
+   re-placing every word */
+void hsh_set_hash(hsh_dic* s, hsh_hash_fn fn, const uint64_t seed[2]);
+
+/* Default hash: SipHash-1-3, keyed by the table seed */
+uint64_t hsh_siphash(const char* str, size_t len, const uint64_t seed[2]);
+
+/* Fills seed with fresh random bits for a keyed hash */
+void hsh_random_seed(uint64_t seed[2]);
+
+/* The original djb2, cheaper but easy to flood */
+uint64_t hsh_djb2(const char* str, size_t len, const uint64_t seed[2]);
+
+/* Fills st with the shape of s: load, probe lengths, growth, bytes */
+void hsh_get_stats(hsh_dic* s, hsh_stats* st);
+
+/* Prints the stats from hsh_get_stats */
+void hsh_print_stats(hsh_stats* st);
+
+/* Prints every occupied slot */
+void hsh_print(hsh_dic* s);
+
+#endif
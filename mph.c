@@ -0,0 +1,327 @@
+/***************************************
+ *        MINIMAL PERFECT HASH         *
+ *_____________________________________*
+ * - PTHash style: a word's hash picks *
+ *   a bucket, and the bucket's pilot  *
+ *   is xor'd into the hash to pick    *
+ *   its slot                          *
+ * - built biggest bucket first, each  *
+ *   pilot is the first one that puts  *
+ *   all of its words on free slots    *
+ * - n words, n slots, no probing: the *
+ *   stored word is only compared to   *
+ *   turn away words never added       *
+ *_____________________________________*
+ ***************************************/
+#include <string.h>
+#include "mph.h"
+#include "hsh.h"
+
+#define MAX_SEEDS 8
+#define GOLDEN 0x9e3779b97f4a7c15ULL
+
+/*words gathered from the dic while building*/
+struct _gather {
+   mph* m;
+   size_t blob_cap;
+   int cap;
+   uint32_t* offs;
+};
+typedef struct _gather gather;
+
+static void gather_word(char* v, void* arg);
+static bool place_all(mph* m, uint64_t* hashes, uint32_t* word_offs);
+static uint32_t bucket_of(mph* m, uint64_t h);
+static uint32_t slot_of(mph* m, uint64_t h, uint32_t pilot);
+static size_t word_len(mph* m, char* v);
+
+/*Builds a perfect hash over the words now in s, s is left as it was*/
+mph* mph_build(dic* s)
+{
+   mph* m = NULL;
+   gather g;
+   uint64_t* hashes;
+   int i;
+
+   if (s == NULL){
+      return NULL;
+   }
+
+   m = (mph*) calloc(1, sizeof(mph));
+   if (m == NULL){
+      ON_ERROR("Creation of Perfect Hash Failed\n");
+   }
+   m->max_str = s->max_str;
+
+   /*copy every word into one blob, in dic order for now*/
+   memset(&g, 0, sizeof(gather));
+   g.m = m;
+   dic_foreach(s, gather_word, &g);
+
+   m->num_buckets = m->num_elem / MPH_BUCKET_SIZE + 1;
+   m->pilots = (uint32_t*) calloc(m->num_buckets, sizeof(uint32_t));
+   m->offs = (uint32_t*) calloc(m->num_elem + 1, sizeof(uint32_t));
+   hashes = (uint64_t*) malloc((m->num_elem + 1) * sizeof(uint64_t));
+   if ( m->pilots == NULL || m->offs == NULL || hashes == NULL ){
+      ON_ERROR("\nPerfect hash allocation failed");
+   }
+
+   /*a failed build (two words hashing alike) only needs a new seed*/
+   do {
+      if (m->num_seeds == MAX_SEEDS){
+         ON_ERROR("\nPerfect hash build failed, duplicate words?");
+      }
+      hsh_random_seed(m->seed);
+      m->num_seeds++;
+      for (i = 0; i < m->num_elem; i++){
+         hashes[i] = hsh_siphash(m->blob + g.offs[i],
+                                 strlen(m->blob + g.offs[i]), m->seed);
+      }
+   } while ( !place_all(m, hashes, g.offs) );
+
+   free(hashes);
+   free(g.offs);
+   return m;
+}
+
+/* Returns true if v is in the table, false elsewise */
+bool mph_isin(mph* m, char* v)
+{
+   return mph_index(m, v) >= 0 ? true : false;
+}
+
+/* Slot of v in 0..num_elem-1 (index for a side array), -1 if absent */
+long mph_index(mph* m, char* v)
+{
+   uint64_t h;
+   uint32_t slot;
+   size_t len;
+   char* w;
+
+   if ( m == NULL || v == NULL || m->num_elem == 0 ){
+      return -1;
+   }
+
+   len = word_len(m, v);
+   h = hsh_siphash(v, len, m->seed);
+   slot = slot_of(m, h, m->pilots[bucket_of(m, h)]);
+
+   w = m->blob + m->offs[slot];
+   if ( memcmp(w, v, len) != 0 || w[len] != '\0' ){
+      return -1;
+   }
+   return (long) slot;
+}
+
+/* Number of words in the table */
+int mph_size(mph* m)
+{
+   if ( m == NULL ){
+      return 0;
+   }
+   return m->num_elem;
+}
+
+/* Bytes used by pilots, slots and words */
+size_t mph_bytes(mph* m)
+{
+   if ( m == NULL ){
+      return 0;
+   }
+   return sizeof(mph) + m->num_buckets * sizeof(uint32_t) +
+          m->num_elem * sizeof(uint32_t) + m->blob_len;
+}
+
+/* Clears all space used, and sets pointer to NULL */
+void mph_free(mph** m)
+{
+   mph* p_m;
+
+   if ( m == NULL ){
+      return;
+   }
+
+   p_m = *m;
+   if ( p_m == NULL ){
+      return;
+   }
+
+   free(p_m->pilots);
+   free(p_m->offs);
+   free(p_m->blob);
+   free(p_m);
+   *m = NULL;
+}
+
+static void gather_word(char* v, void* arg)
+{
+   gather* g = (gather*) arg;
+   mph* m = g->m;
+   size_t len = word_len(m, v);
+
+   if ( m->blob_len + len + 1 > UINT32_MAX ){
+      ON_ERROR("\nPerfect hash words exceed 4GB");
+   }
+
+   if ( m->blob_len + len + 1 > g->blob_cap ){
+      g->blob_cap = g->blob_cap ? g->blob_cap * 2 : 4096;
+      if ( g->blob_cap < m->blob_len + len + 1 ){
+         g->blob_cap = m->blob_len + len + 1;
+      }
+      m->blob = (char*) realloc(m->blob, g->blob_cap);
+      if ( m->blob == NULL ){
+         ON_ERROR("\nPerfect hash blob allocation failed");
+      }
+   }
+
+   if ( m->num_elem == g->cap ){
+      g->cap = g->cap ? g->cap * 2 : 1024;
+      g->offs = (uint32_t*) realloc(g->offs, g->cap * sizeof(uint32_t));
+      if ( g->offs == NULL ){
+         ON_ERROR("\nPerfect hash allocation failed");
+      }
+   }
+
+   g->offs[m->num_elem++] = (uint32_t) m->blob_len;
+   memcpy(m->blob + m->blob_len, v, len);
+   m->blob[m->blob_len + len] = '\0';
+   m->blob_len += len + 1;
+}
+
+static bool place_all(mph* m, uint64_t* hashes, uint32_t* word_offs)
+{
+   /*false if some bucket can't be placed with this seed*/
+   int n = m->num_elem, nb = m->num_buckets;
+   int* start = (int*) calloc(nb + 1, sizeof(int));
+   int* members = (int*) malloc((n + 1) * sizeof(int));
+   int* order = (int*) malloc(nb * sizeof(int));
+   int* by_size;
+   int* fill;
+   uint32_t* slots = (uint32_t*) malloc((n + 1) * sizeof(uint32_t));
+   unsigned char* taken = (unsigned char*) calloc(n + 1, 1);
+   int i, j, k, b, size, max_size = 0;
+   uint32_t pilot;
+   bool ok = true;
+
+   if ( start == NULL || members == NULL || order == NULL ||
+        slots == NULL || taken == NULL ){
+      ON_ERROR("\nPerfect hash allocation failed");
+   }
+
+   /*words grouped by bucket, counting sort*/
+   for (i = 0; i < n; i++){
+      start[bucket_of(m, hashes[i]) + 1]++;
+   }
+   for (b = 0; b < nb; b++){
+      if ( start[b + 1] > max_size ){
+         max_size = start[b + 1];
+      }
+      start[b + 1] += start[b];
+   }
+   fill = (int*) malloc(nb * sizeof(int));
+   if ( fill == NULL ){
+      ON_ERROR("\nPerfect hash allocation failed");
+   }
+   for (b = 0; b < nb; b++){
+      fill[b] = start[b + 1] - start[b];
+   }
+   for (i = n - 1; i >= 0; i--){
+      b = bucket_of(m, hashes[i]);
+      members[start[b] + --fill[b]] = i;
+   }
+   free(fill);
+
+   /*buckets biggest first, again a counting sort*/
+   by_size = (int*) calloc(max_size + 2, sizeof(int));
+   if ( by_size == NULL ){
+      ON_ERROR("\nPerfect hash allocation failed");
+   }
+   for (b = 0; b < nb; b++){
+      by_size[max_size - (start[b + 1] - start[b]) + 1]++;
+   }
+   for (i = 0; i <= max_size; i++){
+      by_size[i + 1] += by_size[i];
+   }
+   for (b = 0; b < nb; b++){
+      order[by_size[max_size - (start[b + 1] - start[b])]++] = b;
+   }
+   free(by_size);
+
+   for (i = 0; i < nb && ok; i++){
+      b = order[i];
+      size = start[b + 1] - start[b];
+      if ( size == 0 ){
+         break;
+      }
+
+      /*a bucket of one finds a free slot within ~n tries, but two
+        words with the same hash never split: give up and reseed   */
+      for (pilot = 0; ; pilot++){
+         for (j = 0; j < size; j++){
+            slots[j] = slot_of(m, hashes[members[start[b] + j]], pilot);
+            if ( taken[slots[j]] ){
+               break;
+            }
+            for (k = 0; k < j; k++){
+               if ( slots[k] == slots[j] ){
+                  break;
+               }
+            }
+            if ( k < j ){
+               break;
+            }
+         }
+         if ( j == size ){
+            break;
+         }
+         if ( pilot == UINT32_MAX || (size > 1 && (uint64_t) pilot > (uint64_t) n * 64 + 1024) ){
+            ok = false;
+            break;
+         }
+      }
+
+      if ( ok ){
+         m->pilots[b] = pilot;
+         for (j = 0; j < size; j++){
+            taken[slots[j]] = 1;
+            m->offs[slots[j]] = word_offs[members[start[b] + j]];
+         }
+      }
+   }
+
+   free(start);
+   free(members);
+   free(order);
+   free(slots);
+   free(taken);
+   return ok;
+}
+
+static uint32_t bucket_of(mph* m, uint64_t h)
+{
+   /*high half picks the bucket, without a divide*/
+   return (uint32_t) (((h >> 32) * (uint64_t) m->num_buckets) >> 32);
+}
+
+static uint32_t slot_of(mph* m, uint64_t h, uint32_t pilot)
+{
+   /*the pilot is spread over all 64 bits before the xor, then the
+     mix makes any change to it a fresh slot                       */
+   uint64_t x = h ^ ((uint64_t) (pilot + 1) * GOLDEN);
+
+   x ^= x >> 33;
+   x *= 0xff51afd7ed558ccdULL;
+   x ^= x >> 33;
+   return (uint32_t) (((x & 0xffffffffULL) * (uint64_t) m->num_elem) >> 32);
+}
+
+static size_t word_len(mph* m, char* v)
+{
+   /*engines keep only max_str - 1 bytes, so does the blob*/
+   size_t len = strlen(v);
+
+   if ( len > (size_t) m->max_str - 1 ){
+      len = m->max_str - 1;
+   }
+   return len;
+}
@@ -0,0 +1,49 @@
+/**********************************
+ *   Minimal Perfect Hash H file  *
+ *________________________________*
+ * read only copy of a finished   *
+ * dic: every word owns exactly   *
+ * one of n slots, so a lookup is *
+ * one hash, one slot, one compare*
+ **********************************/
+#ifndef MPH_H
+#define MPH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "dic.h"
+
+#define MPH_BUCKET_SIZE 4 /*average words per pilot*/
+
+struct _mph {
+   int num_elem;        /*also the number of slots*/
+   int max_str;
+   int num_buckets;
+   uint32_t* pilots;    /*one per bucket, moves its words to free slots*/
+   uint32_t* offs;      /*slot -> word in blob*/
+   char* blob;          /*all words, '\0' separated*/
+   size_t blob_len;
+   uint64_t seed[2];
+   int num_seeds;       /*build attempts it took*/
+};
+typedef struct _mph mph;
+
+/*Builds a perfect hash over the words now in s, s is left as it was*/
+mph* mph_build(dic* s);
+
+/* Returns true if v is in the table, false elsewise */
+bool mph_isin(mph* m, char* v);
+
+/* Slot of v in 0..num_elem-1 (index for a side array), -1 if absent */
+long mph_index(mph* m, char* v);
+
+/* Number of words in the table */
+int mph_size(mph* m);
+
+/* Bytes used by pilots, slots and words */
+size_t mph_bytes(mph* m);
+
+/* Clears all space used, and sets pointer to NULL */
+void mph_free(mph** m);
+
+#endif
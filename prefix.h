@@ -0,0 +1,44 @@
+/**********************************
+ *       Key Prefix H file        *
+ *________________________________*
+ * a word's first 8 bytes as one  *
+ * big endian integer: integers   *
+ * order like strcmp, so a tree   *
+ * node settles most compares     *
+ * without reading its string     *
+ **********************************/
+#ifndef PREFIX_H
+#define PREFIX_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PREFIX_LEN 8
+
+/*first PREFIX_LEN bytes of v, zero padded past its end*/
+static inline uint64_t key_prefix(const char* v)
+{
+   uint64_t p = 0;
+   int i;
+
+   for (i = 0; i < PREFIX_LEN && v[i] != '\0'; i++){
+      p |= (uint64_t) (unsigned char) v[i] << (56 - 8 * i);
+   }
+   return p;
+}
+
+/*strcmp(v, w) given their prefixes: strings are only read when the
+  prefixes tie and neither word ends inside them                  */
+static inline int key_compare(const char* v, uint64_t pv, const char* w,
+                              uint64_t pw)
+{
+   if ( pv != pw ){
+      return pv < pw ? -1 : 1;
+   }
+   if ( (pv & 0xff) == 0 ){
+      return 0;
+   }
+   return strcmp(v + PREFIX_LEN, w + PREFIX_LEN);
+}
+
+#endif
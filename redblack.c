@@ -9,6 +9,9 @@
  ***************************************/
 
 #include <assert.h>
+#include "redblack.h"
+#include "hot.h"
+#include "prefix.h"
 
 #define RED_AUNT a != NULL && a->color == red
 #define IS_ROOT n->parent == NULL
@@ -19,40 +22,78 @@
 #define LEFT_RIGHT p == gl && n == p->right
 
 /*primary*/
-void insert_node( Node* r, Node* n);
-Node* create_node( dic* s);
-void set_node_value( Node* n, char* v);
-void isin_tree( Node* n, char* v, bool* isin);
-void free_tree( Node* n); 
+static bool insert_node( rb_node* r, rb_node* n);
+static rb_node* create_node( rb_dic* s);
+static void set_node_value( rb_node* n, char* v);
+static void isin_tree( rb_node* n, char* v, uint64_t pv, bool* isin);
+static void free_tree( rb_node* n); 
+static rb_node* find_node( rb_node* n, char* v);
+static rb_node* attach(rb_dic* s, rb_node* r, char* v, uint64_t pv,
+                       bool* added);
+static rb_node* finger(rb_node* h, char* v, uint64_t pv, bool* found);
+static void unlink_node(rb_dic* s, rb_node* z);
+static void walk_tree( rb_node* n, void (*f)(char* v, void* arg), void* arg);
+
+/*set operations*/
+enum _set_op {set_union, set_intersect, set_difference};
+typedef enum _set_op set_op;
+static rb_dic* merge_trees(rb_dic* a, rb_dic* b, set_op op);
+static rb_node** flatten_tree(rb_dic* s);
+static void fill_nodes(rb_node* n, rb_node** out, int* i);
+static rb_node* build_tree(rb_dic* s, rb_node** src, int lo, int hi,
+                           int depth, int red_depth, rb_node* p);
+
+/*persistent mode*/
+static rb_node* cow_attach(rb_dic* s, char* v, bool* added);
+static rb_node* cow_insert(rb_dic* s, rb_node* n, char* v, uint64_t pv,
+                           rb_node** hit, bool* added);
+static rb_node* cow_balance(rb_dic* s, rb_node* z);
+static rb_node* own_node(rb_dic* s, rb_node* n);
+static void retain_node(rb_node* n);
+static void release_node(rb_node* n);
+static bool is_red(rb_node* n);
 
 /*rebalancing*/
-void rebalance(dic* s, Node* n);
-void repaint(Node* n);
-void double_left(dic* s, Node* n);
-void double_right(dic* s, Node* n);
-void rotate(dic* s, Node* n);
-void rotate_left(dic* s, Node* n);
-void rotate_right(dic* s, Node* n);
+static void rebalance(rb_dic* s, rb_node* n);
+static void repaint(rb_dic* s, rb_node* n);
+static void double_left(rb_dic* s, rb_node* n);
+static void double_right(rb_dic* s, rb_node* n);
+static void rotate(rb_dic* s, rb_node* n);
+static void rotate_left(rb_dic* s, rb_node* n);
+static void rotate_right(rb_dic* s, rb_node* n);
+static void remove_fixup(rb_dic* s, rb_node* x, rb_node* p);
 
 /*helper*/
-void set_parent(Node* p, Node* n, Node* c);
-void set_new_root(dic* s, Node* n); 
-void go_left(Node* r, Node* n);
-void go_right(Node* r, Node* n);
-void check_left(Node* n, char* v, bool* isin);
-void check_right(Node* n, char* v, bool* isin);
-void print_tree( Node* n);
+static void set_parent(rb_node* p, rb_node* n, rb_node* c);
+static int node_size(rb_node* n);
+static void resize(rb_node* n);
+static void resize_path(rb_node* n, int delta);
+static void set_new_root(rb_dic* s, rb_node* n); 
+static bool go_left(rb_node* r, rb_node* n);
+static bool go_right(rb_node* r, rb_node* n);
+static void check_left(rb_node* n, char* v, uint64_t pv, bool* isin);
+static void check_right(rb_node* n, char* v, uint64_t pv, bool* isin);
 
 /*node relations*/
-Node* parent(Node* n);
-Node* grandp(Node* n);
-Node* sibling(Node* n);
-Node* aunt(Node* n); 
+static rb_node* parent(rb_node* n);
+static rb_node* grandp(rb_node* n);
+static rb_node* sibling(rb_node* n);
+static rb_node* aunt(rb_node* n); 
+static bool is_black(rb_node* n);
+
+/*stats walk*/
+typedef struct _rb_walk {
+   rb_node* n;
+   int depth;
+   int blacks;
+} rb_walk;
+static rb_walk* push_walk(rb_walk* stack, int* top, int* cap, rb_node* n,
+                          int depth, int blacks);
 
 /*Create empty dic*/
-dic* dic_init(int size) 
+rb_dic* rb_init(int size) 
 {
-   dic* dl = (dic*) calloc(1,sizeof(dic));
+   rb_dic* dl = (rb_dic*) calloc(1,sizeof(rb_dic));
    if(dl == NULL){
       ON_ERROR("Creation of Dictionary Failed\n");
    }
@@ -67,10 +108,43 @@ dic* dic_init(int size)
    return dl; 
 }
 
+/* Create empty dic whose inserts copy the root to node path instead
+   of changing shared nodes, so rb_snapshot is O(1). No rb_remove */
+rb_dic* rb_init_persistent(int size)
+{
+   rb_dic* dl = rb_init(size);
+
+   dl->persistent = true;
+   return dl;
+}
+
+/* Read only view of a persistent s as it is now, O(1). Later writes
+   to s don't show in it (and the other way round). Take it on the
+   writer's thread, then read and rb_free it from any thread, as
+   long as no rb_hot_cache is put on it */
+rb_dic* rb_snapshot(rb_dic* s)
+{
+   rb_dic* snap;
+
+   if ( s == NULL ){
+      return NULL;
+   }
+   if ( !s->persistent ){
+      ON_ERROR("\nRb_snapshot() needs a dic from rb_init_persistent");
+   }
+
+   snap = rb_init(s->max_str);
+   snap->persistent = true;
+   snap->num_nodes = s->num_nodes;
+   snap->root = s->root;
+   retain_node(snap->root);
+   return snap;
+}
+
 /* Add one element into the dic */
-void dic_insert(dic* s, char* v)
+void rb_insert(rb_dic* s, char* v)
 { 
-   Node* n;
+   rb_node* n;
 
    if ( v == NULL || s == NULL ){
       return; 
@@ -80,56 +154,71 @@ void dic_insert(dic* s, char* v)
       return; 
    }
 
+   if ( s->persistent ){
+      /*look first, a duplicate shouldn't copy anything*/
+      if ( find_node(s->root, v) == NULL ){
+         cow_attach(s, v, NULL);
+      }
+      return;
+   }
+
    n = create_node(s); 
    set_node_value(n, v); 
 
    if ( s->root == NULL ){
       set_new_root(s, n); 
+      s->num_nodes++;
       return;  
    }
 
-   insert_node(s->root, n);
+   /*duplicates are freed by insert_node*/
+   if ( !insert_node(s->root, n) ){
+      return; 
+   }
+   s->num_nodes++;
+   resize_path(parent(n), 1);
 
    rebalance(s, n); 
 }
 
-void set_new_root(dic* s, Node* n)
+static void set_new_root(rb_dic* s, rb_node* n)
 {
    s->root = n;
    n->color = black; /*increases black height by one*/ 
    n->parent = NULL; 
 }
 
-void rebalance(dic* s, Node* n)
+static void rebalance(rb_dic* s, rb_node* n)
 {
-   Node* a = aunt(n);          
+   rb_node* a = aunt(n);          
 
    if ( IS_ROOT ){
       n->color = black;                      
    } else if ( TREE_BALANCED ){
       return; 
    } else if ( RED_AUNT ){
-      repaint(n); 
+      repaint(s, n); 
    } else { 
       /*parent is red and aunt is black (or NULL)*/
       rotate(s, n);                                
    }
 }
 
-void repaint(Node* n)
+static void repaint(rb_dic* s, rb_node* n)
 {
   /*both new node and parent/aunt red breaks rule that all 
     red nodes have black children. Thus parent + aunt 
     must become black and grandparent must become red     */
 
-   Node* p = parent(n); 
-   Node* g = grandp(n); 
-   Node* a = aunt(n); 
+   rb_node* p = parent(n); 
+   rb_node* g = grandp(n); 
+   rb_node* a = aunt(n); 
 
    if (a == NULL || a->color != red){
       return; 
    }
 
+   s->num_repaint++;
    p->color = black;
    if (a != NULL){
       a->color = black; 
@@ -138,18 +227,18 @@ void repaint(Node* n)
       g->color = red; 
    }
 
-   repaint(g); /*continue repainting up tree*/
+   rebalance(s, g); /*g may now clash with its parent, go on up tree*/
 
 }
 
-void rotate(dic* s, Node* n)
+static void rotate(rb_dic* s, rb_node* n)
 {
    /*parent = red, aunt = black (or NULL) 
      This requires rotation              */
-   Node* p = parent(n);
-   Node* g = grandp(n); 
-   Node* gl; 
-   Node* gr;
+   rb_node* p = parent(n);
+   rb_node* g = grandp(n); 
+   rb_node* gl; 
+   rb_node* gr;
 
    if (g == NULL) {
       return;
@@ -197,28 +286,61 @@ void rotate(dic* s, Node* n)
    }
 }
 
-void double_left(dic* s, Node* n)
+static void double_left(rb_dic* s, rb_node* n)
 {
-   Node* g = grandp(n);
-   Node* p = parent(n); 
+   rb_node* g = grandp(n);
+   rb_node* p = parent(n); 
 
       rotate_right(s, g); 
       g->color = red;
       p->color = black; 
 }
 
-void double_right(dic* s, Node* n)
+static void double_right(rb_dic* s, rb_node* n)
 {
-   Node* g = grandp(n);
-   Node* p = parent(n);
+   rb_node* g = grandp(n);
+   rb_node* p = parent(n);
 
       rotate_left(s, g);
-      g->color = black;
-      p->color = red; 
+      g->color = red;
+      p->color = black; 
+}
+
+/* Adds v starting the search at hint, returns the node holding v */
+rb_node* rb_insert_hint(rb_dic* s, char* v, rb_node* hint)
+{
+   rb_node* start;
+   uint64_t pv;
+   bool found = false;
+
+   if ( v == NULL || s == NULL ){
+      return NULL; 
+   }
+
+   if ( strlen(v) < 1 ){
+      return NULL; 
+   }
+
+   if ( s->persistent ){
+      /*copied paths have no parent links to climb*/
+      rb_insert(s, v);
+      return NULL;
+   }
+
+   pv = key_prefix(v);
+   if ( hint == NULL || s->root == NULL ){
+      return attach(s, s->root, v, pv, NULL);
+   }
+
+   start = finger(hint, v, pv, &found);
+   if ( found ){
+      return start;
+   }
+   return attach(s, start, v, pv, NULL);
 }
 
 /* Returns true if v is in the array, false elsewise */
-bool dic_isin(dic* s, char* v)
+bool rb_isin(rb_dic* s, char* v)
 {
    bool isin = false;
 
@@ -230,18 +352,809 @@ bool dic_isin(dic* s, char* v)
       return false; 
    }
 
-   isin_tree(s->root, v, &isin);
+   if ( s->hot != NULL && hot_find(s->hot, v) ){
+      return true;
+   }
+
+   isin_tree(s->root, v, key_prefix(v), &isin);
 
    if ( isin ){
+      hot_add(s->hot, v);
       return true; 
    }
    return false; 
 }
 
+/* Puts a cache of about entries recently found words in front of
+   rb_isin, 0 removes it. Lookups then write the cache, so a cached
+   dic (snapshots included) must be read from one thread only */
+void rb_hot_cache(rb_dic* s, int entries)
+{
+   if ( s == NULL ){
+      return;
+   }
+
+   hot_free(&s->hot);
+   if ( entries > 0 ){
+      s->hot = hot_init(entries, s->max_str);
+   }
+}
+
+/* Removes v, returns true if it was in the dic */
+bool rb_remove(rb_dic* s, char* v)
+{
+   rb_node* z;
+
+   if ( v == NULL || s == NULL ){
+      return false; 
+   }
+
+   if ( s->persistent ){
+      ON_ERROR("\nRb_remove() isn't supported on persistent dics");
+   }
+
+   z = find_node(s->root, v);
+   if ( z == NULL ){
+      return false; 
+   }
+
+   hot_drop(s->hot, v);
+   unlink_node(s, z);
+   s->num_nodes--;
+   return true; 
+}
+
+/* Copies the value stored with v into out, returns false if v isn't in */
+bool rb_get(rb_dic* s, char* v, dic_val* out)
+{
+   rb_node* n;
+
+   if ( v == NULL || s == NULL ){
+      return false; 
+   }
+
+   n = find_node(s->root, v);
+   if ( n == NULL ){
+      return false; 
+   }
+   if ( out != NULL ){
+      *out = n->val;
+   }
+   return true; 
+}
+
+/* Stores val with v, adding v if needed */
+void rb_put(rb_dic* s, char* v, dic_val val)
+{
+   dic_val* slot = rb_slot(s, v, NULL);
+
+   if ( slot != NULL ){
+      *slot = val;
+   }
+}
+
+/* Value slot for v, added (zeroed) if missing, in one descent */
+dic_val* rb_slot(rb_dic* s, char* v, bool* added)
+{
+   rb_node* n;
+
+   if ( v == NULL || s == NULL ){
+      return NULL; 
+   }
+
+   if ( strlen(v) < 1 ){
+      return NULL; 
+   }
+
+   /*persistent: the path is copied even when v is in, so the
+     slot is never one a snapshot can see                      */
+   n = s->persistent ? cow_attach(s, v, added) :
+                       attach(s, s->root, v, key_prefix(v), added);
+   return &n->val;
+}
+
+static rb_node* attach(rb_dic* s, rb_node* r, char* v, uint64_t pv,
+                       bool* added)
+{
+   /*finds v below r (the root, or a subtree v's range falls in), or
+     hangs a new node for it where the search ended and rebalances.
+     Nodes don't move, so the result stays valid                     */
+   rb_node* n;
+   int compare = 0;
+
+   while ( r != NULL ){
+      compare = key_compare(v, pv, r->pstr, r->prefix);
+      if ( compare == 0 ){
+         if ( added != NULL ){
+            *added = false;
+         }
+         return r;
+      }
+      if ( compare < 0 && r->left == NULL ){
+         break;
+      }
+      if ( compare > 0 && r->right == NULL ){
+         break;
+      }
+      r = compare < 0 ? r->left : r->right;
+   }
+
+   n = create_node(s);
+   set_node_value(n, v);
+   s->num_nodes++;
+   if ( added != NULL ){
+      *added = true;
+   }
+
+   if ( r == NULL ){
+      set_new_root(s, n);
+      return n;
+   }
+
+   if ( compare < 0 ){
+      r->left = n;
+   } else {
+      r->right = n;
+   }
+   n->parent = r;
+   resize_path(r, 1);
+
+   rebalance(s, n);
+   return n;
+}
+
+static rb_node* finger(rb_node* h, char* v, uint64_t pv, bool* found)
+{
+   /*lowest node whose subtree range holds v. Going up from the
+     side v is on leaves the bound facing v as it was, so only
+     ancestors reached the other way need a compare: the first one
+     past v brackets it and the descent starts from the last node
+     passed. Appending after the largest word climbs the right spine
+     with no compares and hangs v straight off h                     */
+   rb_node* start = h;
+   rb_node* n = h;
+   rb_node* p;
+   int compare = key_compare(v, pv, h->pstr, h->prefix);
+   int c;
+
+   if ( compare == 0 ){
+      *found = true;
+      return h;
+   }
+
+   for (p = parent(n); p != NULL; n = p, p = parent(n)){
+      if ( (compare > 0) == (n == p->right) ){
+         continue;
+      }
+      c = key_compare(v, pv, p->pstr, p->prefix);
+      if ( c == 0 ){
+         *found = true;
+         return p;
+      }
+      if ( (c > 0) != (compare > 0) ){
+         break;
+      }
+      start = p;
+   }
+   return start;
+}
+
+/* Calls f on every word in the dic, in sorted order */
+void rb_foreach(rb_dic* s, void (*f)(char* v, void* arg), void* arg)
+{
+   if ( s == NULL || f == NULL ){
+      return; 
+   }
+   walk_tree(s->root, f, arg);
+}
+
+static void walk_tree(rb_node* n, void (*f)(char* v, void* arg), void* arg)
+{
+   if ( n == NULL ){
+      return; 
+   }
+   walk_tree(n->left, f, arg);
+   f(n->pstr, arg);
+   walk_tree(n->right, f, arg);
+}
+
+static rb_node* find_node(rb_node* n, char* v)
+{
+   uint64_t pv = key_prefix(v);
+   int compare;
+
+   while ( n != NULL ){
+      compare = key_compare(v, pv, n->pstr, n->prefix);
+      if ( compare == 0 ){
+         return n;
+      }
+      n = compare < 0 ? n->left : n->right;
+   }
+   return NULL;
+}
+
+static void unlink_node(rb_dic* s, rb_node* z)
+{
+   /*a node with two children swaps its word with its in-order
+     successor, which has at most one child, and that is unlinked */
+   rb_node* y = z;
+   rb_node* x;
+   rb_node* p;
+   char* tmp;
+
+   if ( z->left != NULL && z->right != NULL ){
+      y = z->right;
+      while ( y->left != NULL ){
+         y = y->left;
+      }
+      tmp = z->pstr;
+      z->pstr = y->pstr;
+      y->pstr = tmp;
+      z->prefix = y->prefix;
+      z->val = y->val;
+   }
+
+   x = y->left != NULL ? y->left : y->right;
+   p = parent(y);
+
+   if ( x != NULL ){
+      x->parent = p;
+   }
+   if ( p == NULL ){
+      s->root = x;
+   } else {
+      set_parent(p, y, x);
+   }
+   /*sizes are right again before any fixup rotation reads them*/
+   resize_path(p, -1);
+
+   /*removing a black node shortens every path through it*/
+   if ( y->color == black ){
+      remove_fixup(s, x, p);
+   }
+
+   free(y->pstr);
+   free(y);
+}
+
+static void remove_fixup(rb_dic* s, rb_node* x, rb_node* p)
+{
+   /*x carries an extra black; push it up until it lands on a
+     red node or the root, rotating where a sibling can absorb it.
+     x may be a NULL leaf, so its parent p is tracked separately  */
+   rb_node* w;
+
+   while ( x != s->root && is_black(x) && p != NULL ){
+
+      if ( x == p->left ){
+         w = p->right;
+         if ( w != NULL && w->color == red ){
+            w->color = black;
+            p->color = red;
+            rotate_left(s, p);
+            w = p->right;
+         }
+         if ( w == NULL ){
+            x = p;
+            p = parent(x);
+         } else if ( is_black(w->left) && is_black(w->right) ){
+            w->color = red;
+            x = p;
+            p = parent(x);
+         } else {
+            if ( is_black(w->right) ){
+               w->left->color = black;
+               w->color = red;
+               rotate_right(s, w);
+               w = p->right;
+            }
+            w->color = p->color;
+            p->color = black;
+            if ( w->right != NULL ){
+               w->right->color = black;
+            }
+            rotate_left(s, p);
+            x = s->root;
+            p = NULL;
+         }
+      } else {
+         w = p->left;
+         if ( w != NULL && w->color == red ){
+            w->color = black;
+            p->color = red;
+            rotate_right(s, p);
+            w = p->left;
+         }
+         if ( w == NULL ){
+            x = p;
+            p = parent(x);
+         } else if ( is_black(w->left) && is_black(w->right) ){
+            w->color = red;
+            x = p;
+            p = parent(x);
+         } else {
+            if ( is_black(w->left) ){
+               w->right->color = black;
+               w->color = red;
+               rotate_left(s, w);
+               w = p->left;
+            }
+            w->color = p->color;
+            p->color = black;
+            if ( w->left != NULL ){
+               w->left->color = black;
+            }
+            rotate_right(s, p);
+            x = s->root;
+            p = NULL;
+         }
+      }
+   }
+
+   if ( x != NULL ){
+      x->color = black;
+   }
+}
+
+/* New dic of the words in a or b (values from a where both have one),
+   a and b are left as they were. Linear in the two sizes */
+rb_dic* rb_union(rb_dic* a, rb_dic* b)
+{
+   return merge_trees(a, b, set_union);
+}
+
+/* New dic of the words in both a and b, values from a */
+rb_dic* rb_intersect(rb_dic* a, rb_dic* b)
+{
+   return merge_trees(a, b, set_intersect);
+}
+
+/* New dic of the words in a but not in b, values from a */
+rb_dic* rb_difference(rb_dic* a, rb_dic* b)
+{
+   return merge_trees(a, b, set_difference);
+}
+
+static rb_dic* merge_trees(rb_dic* a, rb_dic* b, set_op op)
+{
+   /*both trees flattened in order, merged like the last pass of
+     a merge sort, then the result is built straight into a
+     balanced tree: no per word descent or rebalancing           */
+   rb_dic* s;
+   rb_node** na;
+   rb_node** nb;
+   rb_node** out;
+   int i = 0, j = 0, k = 0, compare, h;
+
+   if ( a == NULL || b == NULL ){
+      ON_ERROR("\nSet operation passed a NULL dic");
+   }
+
+   s = rb_init(a->max_str > b->max_str ? a->max_str : b->max_str);
+   na = flatten_tree(a);
+   nb = flatten_tree(b);
+   out = (rb_node**) malloc(sizeof(rb_node*) *
+                            (a->num_nodes + b->num_nodes + 1));
+   if ( out == NULL ){
+      ON_ERROR("\nSet operation allocation failed");
+   }
+
+   while ( i < a->num_nodes && j < b->num_nodes ){
+      compare = key_compare(na[i]->pstr, na[i]->prefix,
+                            nb[j]->pstr, nb[j]->prefix);
+      if ( compare < 0 ){
+         if ( op != set_intersect ){
+            out[k++] = na[i];
+         }
+         i++;
+      } else if ( compare > 0 ){
+         if ( op == set_union ){
+            out[k++] = nb[j];
+         }
+         j++;
+      } else {
+         if ( op != set_difference ){
+            out[k++] = na[i];
+         }
+         i++;
+         j++;
+      }
+   }
+   while ( i < a->num_nodes && op != set_intersect ){
+      out[k++] = na[i++];
+   }
+   while ( j < b->num_nodes && op == set_union ){
+      out[k++] = nb[j++];
+   }
+
+   if ( k > 0 ){
+      /*every node on the deepest level is red, so all paths
+        carry the same number of blacks                      */
+      for (h = 0; (2 << h) <= k; h++){
+         ;
+      }
+      s->root = build_tree(s, out, 0, k - 1, 0, h, NULL);
+      s->root->color = black;
+   }
+   s->num_nodes = k;
+
+   free(na);
+   free(nb);
+   free(out);
+   return s;
+}
+
+static rb_node** flatten_tree(rb_dic* s)
+{
+   rb_node** out = (rb_node**) malloc(sizeof(rb_node*) * (s->num_nodes + 1));
+   int i = 0;
+
+   if ( out == NULL ){
+      ON_ERROR("\nSet operation allocation failed");
+   }
+   fill_nodes(s->root, out, &i);
+   return out;
+}
+
+static void fill_nodes(rb_node* n, rb_node** out, int* i)
+{
+   if ( n == NULL ){
+      return;
+   }
+   fill_nodes(n->left, out, i);
+   out[(*i)++] = n;
+   fill_nodes(n->right, out, i);
+}
+
+static rb_node* build_tree(rb_dic* s, rb_node** src, int lo, int hi,
+                           int depth, int red_depth, rb_node* p)
+{
+   /*middle of the range at the top, halves either side*/
+   int mid;
+   rb_node* n;
+
+   if ( lo > hi ){
+      return NULL;
+   }
+
+   mid = lo + (hi - lo) / 2;
+   n = create_node(s);
+   set_node_value(n, src[mid]->pstr);
+   n->val = src[mid]->val;
+   n->color = depth == red_depth ? red : black;
+   n->parent = p;
+   n->size = hi - lo + 1;
+   n->left = build_tree(s, src, lo, mid - 1, depth + 1, red_depth, n);
+   n->right = build_tree(s, src, mid + 1, hi, depth + 1, red_depth, n);
+   return n;
+}
+
+static rb_node* cow_attach(rb_dic* s, char* v, bool* added)
+{
+   /*the dic's own reference to the root is handed down like any
+     parent's, so a shared root is copied too                     */
+   rb_node* hit = NULL;
+   bool add = false;
+
+   s->root = cow_insert(s, s->root, v, key_prefix(v), &hit, &add);
+   s->root->color = black;
+   if ( add ){
+      s->num_nodes++;
+   }
+   if ( added != NULL ){
+      *added = add;
+   }
+   return hit;
+}
+
+static rb_node* cow_insert(rb_dic* s, rb_node* n, char* v, uint64_t pv,
+                           rb_node** hit, bool* added)
+{
+   /*returns the node to hang where n was: n itself if nothing else
+     holds it, a copy otherwise, rebalanced on the way back up      */
+   int compare;
+
+   if ( n == NULL ){
+      n = create_node(s);
+      set_node_value(n, v);
+      *hit = n;
+      *added = true;
+      return n;
+   }
+
+   n = own_node(s, n);
+   compare = key_compare(v, pv, n->pstr, n->prefix);
+   if ( compare == 0 ){
+      *hit = n;
+      return n;
+   }
+
+   if ( compare < 0 ){
+      n->left = cow_insert(s, n->left, v, pv, hit, added);
+   } else {
+      n->right = cow_insert(s, n->right, v, pv, hit, added);
+   }
+   resize(n);
+   return cow_balance(s, n);
+}
+
+static rb_node* cow_balance(rb_dic* s, rb_node* z)
+{
+   /*Okasaki's four cases: a black node with a red child and red
+     grandchild becomes a red node over two blacks. Both reds are
+     on the insert path, so they were already copied if shared    */
+   rb_node* x;
+   rb_node* y;
+
+   if ( z->color != black ){
+      return z;
+   }
+
+   if ( is_red(z->left) && is_red(z->left->left) ){
+      y = z->left;
+      x = y->left;
+      z->left = y->right;
+      y->right = z;
+   } else if ( is_red(z->left) && is_red(z->left->right) ){
+      x = z->left;
+      y = x->right;
+      x->right = y->left;
+      z->left = y->right;
+      y->left = x;
+      y->right = z;
+   } else if ( is_red(z->right) && is_red(z->right->left) ){
+      x = z;
+      z = z->right;
+      y = z->left;
+      x->right = y->left;
+      z->left = y->right;
+      y->left = x;
+      y->right = z;
+   } else if ( is_red(z->right) && is_red(z->right->right) ){
+      x = z;
+      y = z->right;
+      z = y->right;
+      x->right = y->left;
+      y->left = x;
+   } else {
+      return z;
+   }
+
+   x->color = black;
+   z->color = black;
+   y->color = red;
+   resize(x);
+   resize(z);
+   resize(y);
+   s->num_rotate++;
+   return y;
+}
+
+static rb_node* own_node(rb_dic* s, rb_node* n)
+{
+   /*a node held once, by a parent that is itself owned, can be
+     changed in place; otherwise the writer takes a copy and drops
+     its reference to the original                                */
+   rb_node* c;
+
+   if ( __atomic_load_n(&n->refs, __ATOMIC_ACQUIRE) == 1 ){
+      return n;
+   }
+
+   c = create_node(s);
+   set_node_value(c, n->pstr);
+   c->val = n->val;
+   c->color = n->color;
+   c->size = n->size;
+   c->left = n->left;
+   c->right = n->right;
+   retain_node(c->left);
+   retain_node(c->right);
+   release_node(n);
+   return c;
+}
+
+static void retain_node(rb_node* n)
+{
+   if ( n != NULL ){
+      __atomic_add_fetch(&n->refs, 1, __ATOMIC_RELAXED);
+   }
+}
+
+static void release_node(rb_node* n)
+{
+   /*frees n and whatever only it held*/
+   if ( n == NULL ){
+      return;
+   }
+   if ( __atomic_sub_fetch(&n->refs, 1, __ATOMIC_ACQ_REL) != 0 ){
+      return;
+   }
+   release_node(n->left);
+   release_node(n->right);
+   free(n->pstr);
+   free(n);
+}
+
+static bool is_red(rb_node* n)
+{
+   return n != NULL && n->color == red ? true : false;
+}
+
+/* Number of words in the dic */
+int rb_size(rb_dic* s)
+{
+   if ( s == NULL ){
+      return 0; 
+   }
+   return s->num_nodes; 
+}
+
+/* Number of words sorting before v (v need not be in), O(log n) */
+int rb_rank(rb_dic* s, char* v)
+{
+   /*each step right passes a node and its whole left subtree*/
+   rb_node* n;
+   uint64_t pv;
+   int rank = 0, compare;
+
+   if ( v == NULL || s == NULL ){
+      return 0; 
+   }
+
+   n = s->root;
+   pv = key_prefix(v);
+   while ( n != NULL ){
+      compare = key_compare(v, pv, n->pstr, n->prefix);
+      if ( compare == 0 ){
+         return rank + node_size(n->left);
+      }
+      if ( compare < 0 ){
+         n = n->left;
+      } else {
+         rank += node_size(n->left) + 1;
+         n = n->right;
+      }
+   }
+   return rank;
+}
+
+/* The k-th word in sorted order, counting from 0, or NULL */
+char* rb_select(rb_dic* s, int k)
+{
+   rb_node* n;
+   int left;
+
+   if ( s == NULL || k < 0 || k >= s->num_nodes ){
+      return NULL; 
+   }
+
+   n = s->root;
+   while ( n != NULL ){
+      left = node_size(n->left);
+      if ( k == left ){
+         return n->pstr;
+      }
+      if ( k < left ){
+         n = n->left;
+      } else {
+         k -= left + 1;
+         n = n->right;
+      }
+   }
+   return NULL;
+}
+
+/* Fills st with the shape of s: height, black height, depths, bytes */
+void rb_get_stats(rb_dic* s, rb_stats* st)
+{
+   /*iterative walk, each frame holds the depth and blacks so far*/
+   rb_walk* stack = NULL;
+   int top = 0, cap = 0, depth, blacks;
+   double depth_total = 0;
+   rb_node* n;
+
+   if ( s == NULL || st == NULL ){
+      ON_ERROR("\nRb_get_stats() passed a NULL value");
+   }
+
+   memset(st, 0, sizeof(rb_stats));
+   st->num_nodes = s->num_nodes;
+   st->num_rotate = s->num_rotate;
+   st->num_repaint = s->num_repaint;
+   st->bytes = sizeof(rb_dic) + 
+               (size_t) s->num_nodes * (sizeof(rb_node) + s->max_str);
+   st->black_height = 0;
+   if ( s->hot != NULL ){
+      st->hot_lookups = s->hot->num_lookups;
+      st->hot_hits = s->hot->num_hits;
+      st->bytes += sizeof(hot_cache) + (size_t) s->hot->num_sets *
+                   (sizeof(hot_set) + HOT_WAYS * s->max_str);
+   }
+
+   if ( s->root == NULL ){
+      return; 
+   }
+
+   stack = push_walk(stack, &top, &cap, s->root, 1, 1);
+   st->black_height = -1;
+
+   while ( top > 0 ){
+      top--;
+      n = stack[top].n;
+      depth = stack[top].depth;
+      blacks = stack[top].blacks;
+
+      depth_total += depth;
+      if ( depth > st->height ){
+         st->height = depth; 
+      }
+
+      /*every path to a leaf must see the same number of blacks*/
+      if ( n->left == NULL || n->right == NULL ){
+         if ( st->black_height == -1 ){
+            st->black_height = blacks; 
+         } else if ( st->black_height != blacks ){
+            st->black_height = -2; 
+         }
+      }
+
+      if ( n->left != NULL ){
+         stack = push_walk(stack, &top, &cap, n->left, depth + 1, 
+                           blacks + is_black(n->left));
+      }
+      if ( n->right != NULL ){
+         stack = push_walk(stack, &top, &cap, n->right, depth + 1, 
+                           blacks + is_black(n->right));
+      }
+   }
+
+   /*-2 only while collecting, a broken tree reports -1*/
+   if ( st->black_height < 0 ){
+      st->black_height = -1; 
+   }
+   st->avg_depth = depth_total / s->num_nodes;
+   free(stack);
+}
+
+/* Prints the stats from rb_get_stats */
+void rb_print_stats(rb_stats* st)
+{
+   if ( st == NULL ){
+      return; 
+   }
+
+   printf("\nnodes %d, height %d, black height %d, avg depth %.2f",
+          st->num_nodes, st->height, st->black_height, st->avg_depth);
+   printf("\nrotations %lu, repaints %lu, bytes %lu\n",
+          st->num_rotate, st->num_repaint, (unsigned long) st->bytes);
+   if ( st->hot_lookups > 0 ){
+      printf("hot cache hits %lu of %lu (%.1f%%)\n", st->hot_hits,
+             st->hot_lookups, 100.0 * st->hot_hits / st->hot_lookups);
+   }
+}
+
+static rb_walk* push_walk(rb_walk* stack, int* top, int* cap, rb_node* n,
+                          int depth, int blacks)
+{
+   if ( *top == *cap ){
+      *cap = *cap ? *cap * 2 : 64;
+      stack = (rb_walk*) realloc(stack, sizeof(rb_walk) * *cap);
+      if ( stack == NULL ){
+         ON_ERROR("\nWalk stack allocation failed");
+      }
+   }
+   stack[*top].n = n;
+   stack[*top].depth = depth;
+   stack[*top].blacks = blacks;
+   (*top)++;
+   return stack;
+}
+
 /* Clears all space used, and sets pointer to NULL */
-void dic_free(dic** s)
+void rb_free(rb_dic** s)
 {
-   dic* p_d;
+   rb_dic* p_d;
 
    if ( s == NULL ){
       return; 
@@ -252,13 +1165,18 @@ void dic_free(dic** s)
       return; 
    }
 
-   free_tree(p_d->root); 
+   hot_free(&p_d->hot);
+   if ( p_d->persistent ){
+      release_node(p_d->root);
+   } else {
+      free_tree(p_d->root); 
+   }
 
    free(p_d);    
-   p_d = NULL;
+   *s = NULL;
 }
 
-void free_tree(Node* n)
+static void free_tree(rb_node* n)
 {
    if (n == NULL){
       return; 
@@ -280,7 +1198,7 @@ void free_tree(Node* n)
    free(n);
 }
 
-void isin_tree(Node* n, char* v, bool* isin)
+static void isin_tree(rb_node* n, char* v, uint64_t pv, bool* isin)
 {
    /*recursively search tree*/
    int compare; 
@@ -290,7 +1208,7 @@ void isin_tree(Node* n, char* v, bool* isin)
       return;
    }
 
-   compare = strcmp(v, n->pstr);
+   compare = key_compare(v, pv, n->pstr, n->prefix);
 
    if ( compare == 0 ) {
       *isin = true;
@@ -299,40 +1217,40 @@ void isin_tree(Node* n, char* v, bool* isin)
 
    if ( compare < 0 ){  
  
-      check_left(n, v, isin); 
+      check_left(n, v, pv, isin); 
 
    } else {              
 
-      check_right(n, v, isin); 
+      check_right(n, v, pv, isin); 
 
    }
    return; 
 }
 
-void check_left(Node* n, char* v, bool* isin)
+static void check_left(rb_node* n, char* v, uint64_t pv, bool* isin)
 {
    if (n->left == NULL){
       *isin = false;
       return; 
    } else {
-      isin_tree(n->left, v, isin);
+      isin_tree(n->left, v, pv, isin);
    }
 }
 
-void check_right(Node* n, char* v, bool* isin)
+static void check_right(rb_node* n, char* v, uint64_t pv, bool* isin)
 {
    if (n->right == NULL){
       *isin = false;
       return; 
    } else {
-      isin_tree(n->right, v, isin); 
+      isin_tree(n->right, v, pv, isin); 
    }
 }
 
-Node* create_node(dic* s)
+static rb_node* create_node(rb_dic* s)
 {
    /*all nodes begin red*/
-   Node* n = (Node*) calloc(1, sizeof(Node));
+   rb_node* n = (rb_node*) calloc(1, sizeof(rb_node));
 
    if ( n == NULL ){
       ON_ERROR("\nFailed to make node"); 
@@ -343,11 +1261,13 @@ Node* create_node(dic* s)
    n->parent = NULL;
    n->color = red; 
    n->max_str = s->max_str;
+   n->refs = 1;
+   n->size = 1;
 
    return n; 
 }
 
-void set_node_value(Node* n, char* v)
+static void set_node_value(rb_node* n, char* v)
 {
    /*get space for word and point pstr to space*/
    n->pstr = (char*) calloc(n->max_str, sizeof(char));
@@ -357,58 +1277,60 @@ void set_node_value(Node* n, char* v)
    }  
 
    strncpy(n->pstr, v, strlen(v));
+   n->prefix = key_prefix(n->pstr);
 }
 
-void insert_node(Node* r, Node* n)
+static bool insert_node(rb_node* r, rb_node* n)
 {
-   /* recursively find correct location and add node there */
+   /* recursively find correct location and add node there,
+      returns false (and frees n) if the word is already in */
    int compare; 
 
-   if ( r == NULL ) {return;}
+   if ( r == NULL ) {return false;}
 
-   compare = strcmp(n->pstr, r->pstr);
+   compare = key_compare(n->pstr, n->prefix, r->pstr, r->prefix);
    if ( compare == 0 ){    /*don't add duplicates*/
       if (n != NULL){
          free(n->pstr);
          free(n); 
       }
-      return; 
+      return false; 
    }
 
    if ( compare < 0 ){
 
-      go_left(r, n); 
+      return go_left(r, n); 
 
    } else { 
 
-     go_right(r, n);              
+     return go_right(r, n);              
 
    }
 } 
 
-void go_left(Node* r, Node* n)
+static bool go_left(rb_node* r, rb_node* n)
 {
    if (r->left == NULL){
       /*add node to r left*/
       r->left = n;
       n->parent = r; 
-   } else {
-      insert_node(r->left, n);
-   }
+      return true;
+   } 
+   return insert_node(r->left, n);
 }
 
-void go_right(Node* r, Node* n)
+static bool go_right(rb_node* r, rb_node* n)
 {
    if (r->right == NULL){
       /*add node to r right*/
       r->right = n;
       n->parent = r;  
-   } else {
-      insert_node(r->right, n); 
-   }
+      return true;
+   } 
+   return insert_node(r->right, n); 
 }
 
-void rotate_left(dic* s, Node* n)
+static void rotate_left(rb_dic* s, rb_node* n)
 {
    /*       (P)               (P)
              |                 |
@@ -417,16 +1339,23 @@ void rotate_left(dic* s, Node* n)
            1   (C)          (N)  3
                /  \         / \
               2    3       1   2                */
-   Node* c = n->right; 
-   Node* p = parent(n); 
+   rb_node* c = n->right; 
+   rb_node* p = parent(n); 
+
+   s->num_rotate++;
 
    if (c == NULL){
       ON_ERROR("\nRotate_left() passed a node with right LEAF");
    }
 
    n->right = c->left; 
+   if (n->right != NULL){
+      n->right->parent = n; 
+   }
    c->left = n; 
    n->parent = c; 
+   c->size = n->size;
+   resize(n);
 
    if (p != NULL){
       set_parent(p, n, c); 
@@ -436,7 +1365,7 @@ void rotate_left(dic* s, Node* n)
    c->parent = p; /*if c is root, p is NULL*/
 }
 
-void rotate_right(dic* s, Node* n)
+static void rotate_right(rb_dic* s, rb_node* n)
 {
 /*           (P)        (P)     
               |          |
@@ -445,16 +1374,23 @@ void rotate_right(dic* s, Node* n)
            (C)  3     1    (N)
           /  \             / \
           1   2            2  3       */
-   Node* c = n->left; 
-   Node* p = parent(n); 
+   rb_node* c = n->left; 
+   rb_node* p = parent(n); 
+
+   s->num_rotate++;
 
    if (c == NULL){
       ON_ERROR("\nRotate_right() passed a node with left LEAF");
    }
 
    n->left = c->right;
+   if (n->left != NULL){
+      n->left->parent = n; 
+   }
    c->right = n;
    n->parent = c; 
+   c->size = n->size;
+   resize(n);
 
    if (p != NULL) { 
       set_parent(p, n, c); 
@@ -465,7 +1401,7 @@ void rotate_right(dic* s, Node* n)
    c->parent = p; 
 }
 
-void set_parent(Node* p, Node* n, Node* c)
+static void set_parent(rb_node* p, rb_node* n, rb_node* c)
 {
   /*set c as either the left or right child of p
     depending on node n's previous location      */
@@ -476,12 +1412,37 @@ void set_parent(Node* p, Node* n, Node* c)
    }
 }
 
-Node* parent (Node* n)
+static int node_size(rb_node* n)
+{
+   return n == NULL ? 0 : n->size;
+}
+
+static void resize(rb_node* n)
+{
+   /*n's size from its children's, which must already be right*/
+   n->size = 1 + node_size(n->left) + node_size(n->right);
+}
+
+static void resize_path(rb_node* n, int delta)
+{
+   /*a node was added or taken below n: n and all above change*/
+   for (; n != NULL; n = parent(n)){
+      n->size += delta;
+   }
+}
+
+static bool is_black(rb_node* n)
+{
+   /*NULL leaves count as black*/
+   return n == NULL || n->color == black;
+}
+
+static rb_node* parent (rb_node* n)
 {
    return n->parent; 
 }
 
-Node* grandp(Node* n)
+static rb_node* grandp(rb_node* n)
 {
    if (n->parent == NULL){
       return NULL; 
@@ -489,9 +1450,9 @@ Node* grandp(Node* n)
    return parent(n->parent); 
 }
 
-Node* sibling(Node* n)
+static rb_node* sibling(rb_node* n)
 {
-   Node* p = parent(n); 
+   rb_node* p = parent(n); 
    if (p == NULL){
       return NULL;
    }
@@ -502,10 +1463,10 @@ Node* sibling(Node* n)
    return p->left; 
 }
 
-Node* aunt (Node* n)
+static rb_node* aunt (rb_node* n)
 {
-   Node* g = grandp(n); 
-   Node* p = parent(n); 
+   rb_node* g = grandp(n); 
+   rb_node* p = parent(n); 
 
    if (g == NULL){
       return NULL; 
@@ -514,14 +1475,14 @@ Node* aunt (Node* n)
    return sibling(p);  
 }
 
-void print_tree(Node* n) 
+void rb_print(rb_node* n) 
 {
    if ( n == NULL ) {
       return; 
    } else {
       printf("\n%s", n->pstr);
-      print_tree(n->left);
-      print_tree(n->right); 
+      rb_print(n->left);
+      rb_print(n->right); 
    }
    printf("\n");
 }
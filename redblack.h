@@ -1,43 +1,131 @@
 /**********************************
  *  RED BLACK SEARCH TREE H file  *
  **********************************/
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
-#define MAXWORD 50
-#define ON_ERROR(STR) fprintf(stderr, STR); exit(EXIT_FAILURE)
+#ifndef REDBLACK_H
+#define REDBLACK_H
 
-enum _bool {false, true};
-typedef enum _bool bool; 
+#include <string.h>
+#include <stdint.h>
+#include "dic.h"
 
 enum _color {black, red}; 
 typedef enum _color Color;  
 
-typedef struct _node {
+typedef struct _rb_node {
+   uint64_t prefix; /*pstr's first 8 bytes, see prefix.h*/
    char *pstr; 
    int max_str; 
    Color color; 
-   struct _node* left;
-   struct _node* right; 
-   struct _node* parent; 
-} Node;
+   dic_val val; 
+   int refs;      /*persistent mode: parents and dics holding it*/
+   int size;      /*nodes in the subtree rooted here, for rank/select*/
+   struct _rb_node* left;
+   struct _rb_node* right; 
+   struct _rb_node* parent;  /*unused in persistent mode*/
+} rb_node;
 
-struct _dic {
-   Node* root;
+struct _rb_dic {
+   rb_node* root;
    int max_str;   
    int num_nodes; 
+   bool persistent; /*inserts copy the path, see rb_snapshot*/
+   struct _hot_cache* hot; /*NULL unless rb_hot_cache was called*/
+   /*rebalancing work, inserts and removals*/
+   unsigned long num_rotate;
+   unsigned long num_repaint;
 };
-typedef struct _dic dic; 
+typedef struct _rb_dic rb_dic; 
+
+struct _rb_stats {
+   int num_nodes;
+   int height;       /*longest root to node path = max lookup depth*/
+   int black_height; /*-1 if the paths disagree*/
+   double avg_depth; /*nodes visited by an average hit*/
+   unsigned long num_rotate;
+   unsigned long num_repaint;
+   size_t bytes;     /*dic, nodes and word buffers*/
+   unsigned long hot_lookups; /*0 without a hot cache*/
+   unsigned long hot_hits;
+};
+typedef struct _rb_stats rb_stats;
 
 /*Create empty dic*/
-dic* dic_init(int size); 
+rb_dic* rb_init(int size); 
+
+/* Create empty dic whose inserts copy the root to node path instead
+   of changing shared nodes, so rb_snapshot is O(1). No rb_remove */
+rb_dic* rb_init_persistent(int size);
+
+/* Read only view of a persistent s as it is now, O(1). Later writes
+   to s don't show in it (and the other way round). Take it on the
+   writer's thread, then read and rb_free it from any thread, as
+   long as no rb_hot_cache is put on it */
+rb_dic* rb_snapshot(rb_dic* s);
 
 /* Add one element into the dic */
-void dic_insert(dic* s, char* v);
+void rb_insert(rb_dic* s, char* v);
+
+/* Adds v starting the search at hint, a node returned by the last
+   call (or NULL), and returns the node now holding v. Climbs from
+   hint only until v's range is bracketed, so near sorted streams pay
+   a few compares instead of a root descent. hint is valid until the
+   next rb_remove. Persistent dics ignore it and return NULL */
+rb_node* rb_insert_hint(rb_dic* s, char* v, rb_node* hint);
 
 /* Returns true if v is in the array, false elsewise */
-bool dic_isin(dic* s, char* v);
+bool rb_isin(rb_dic* s, char* v);
+
+/* Puts a cache of about entries recently found words in front of
+   rb_isin, 0 removes it. Lookups then write the cache, so a cached
+   dic (snapshots included) must be read from one thread only */
+void rb_hot_cache(rb_dic* s, int entries);
+
+/* Copies the value stored with v into out, returns false if v isn't in */
+bool rb_get(rb_dic* s, char* v, dic_val* out);
+
+/* Stores val with v, adding v if needed */
+void rb_put(rb_dic* s, char* v, dic_val val);
+
+/* Value slot for v, added (zeroed) if missing, in one descent.
+   Valid until the next rb_remove */
+dic_val* rb_slot(rb_dic* s, char* v, bool* added);
+
+/* Removes v, returns true if it was in the dic */
+bool rb_remove(rb_dic* s, char* v);
+
+/* Calls f on every word in the dic, in sorted order */
+void rb_foreach(rb_dic* s, void (*f)(char* v, void* arg), void* arg);
+
+/* New dic of the words in a or b (values from a where both have one),
+   a and b are left as they were. Linear in the two sizes */
+rb_dic* rb_union(rb_dic* a, rb_dic* b);
+
+/* New dic of the words in both a and b, values from a */
+rb_dic* rb_intersect(rb_dic* a, rb_dic* b);
+
+/* New dic of the words in a but not in b, values from a */
+rb_dic* rb_difference(rb_dic* a, rb_dic* b);
+
+/* Number of words in the dic, O(1) */
+int rb_size(rb_dic* s);
+
+/* Number of words sorting before v (v need not be in), O(log n) */
+int rb_rank(rb_dic* s, char* v);
+
+/* The k-th word in sorted order, counting from 0, or NULL if k is out
+   of range. O(log n), valid until the word is removed */
+char* rb_select(rb_dic* s, int k);
+
+/* Fills st with the shape of s: height, black height, depths, bytes */
+void rb_get_stats(rb_dic* s, rb_stats* st);
+
+/* Prints the stats from rb_get_stats */
+void rb_print_stats(rb_stats* st);
 
 /* Clears all space used, and sets pointer to NULL */
-void dic_free(dic** s);
+void rb_free(rb_dic** s);
+
+/* Prints the subtree rooted at n */
+void rb_print(rb_node* n);
+
+#endif
@@ -0,0 +1,467 @@
+/***************************************
+ *        PARALLEL SPELL CHECKER       *
+ *_____________________________________*
+ * - loads a word list (one per line)  *
+ *   into any dic engine, then streams *
+ *   text through a three stage pipe:  *
+ *     reader -> workers -> writer     *
+ * - the reader cuts the stream into   *
+ *   chunks on word boundaries, each   *
+ *   worker tokenizes a whole chunk    *
+ *   then looks its words up in one    *
+ *   batch                             *
+ * - the writer prints misspellings    *
+ *   with their byte offsets in input  *
+ *   order, whatever order the chunks  *
+ *   finish in                         *
+ * - stats and MB/s go to stderr       *
+ *_____________________________________*
+ ***************************************/
+#define _POSIX_C_SOURCE 200809L
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <pthread.h>
+#include "dic.h"
+
+/*usage: spell [-e engine] [-t threads] [-c chunk_kb] wordlist [text]*/
+#define DEFAULT_THREADS 4
+#define DEFAULT_CHUNK_KB 1024
+#define CHUNKS_PER_THREAD 4 /*chunks in flight, bounds memory*/
+
+/*a misspelled word: offset and length in the chunk text*/
+typedef struct _miss {
+   size_t off;
+   int len;
+} miss;
+
+struct _chunk {
+   char* text;
+   size_t len;
+   long long base;    /*offset of text[0] in the whole input*/
+   long seq;
+   bool done;
+   /*filled by the worker*/
+   miss* misses;
+   int num_miss;
+   int cap_miss;
+   long num_words;
+};
+typedef struct _chunk chunk;
+
+/*shared between the stages, everything below lock*/
+struct _pipe {
+   dic* d;
+   chunk** ring;      /*chunk seq lives at ring[seq % ring_len]*/
+   int ring_len;
+   long next_read;    /*chunks handed in so far*/
+   long next_work;    /*next one for a worker*/
+   long next_write;   /*next one to print*/
+   bool eof;
+   long long num_bytes;
+   long num_words;
+   long num_miss;
+   pthread_mutex_t lock;
+   pthread_cond_t cond;
+};
+typedef struct _pipe pipe_state;
+
+/*batch of words from one chunk, lowered into one buffer*/
+typedef struct _batch {
+   char* words;       /*MAXWORD bytes per word*/
+   size_t* offs;
+   int* lens;
+   int len;
+   int cap;
+} batch;
+
+static const struct {
+   const char* name;
+   Engine e;
+} engines[] = {
+   {"hsh", hsh_engine}, {"redblack", rb_engine}, {"bst", bst_engine},
+   {"adaptive", ad_engine}, {"adaptive-ordered", ad_ordered_engine},
+   {"art", art_engine}, {"redblack-persistent", rb_persistent_engine},
+   {"bst-treap", bst_treap_engine}, {"bst-splay", bst_splay_engine},
+   {"hsh-compact", hsh_compact_engine}
+};
+
+static dic* load_words(const char* path, Engine e, long* num);
+static void read_input(pipe_state* p, FILE* in, size_t chunk_len);
+static void* worker(void* arg);
+static void* writer(void* arg);
+static void check_chunk(dic* d, chunk* c, batch* b);
+static void add_word(batch* b, const char* w, size_t off, int len);
+static void add_miss(chunk* c, size_t off, int len);
+static bool is_word_char(const char* text, size_t i, size_t len);
+static void free_chunk(chunk* c);
+static double now_secs(void);
+
+int main(int argc, char** argv)
+{
+   pipe_state p;
+   pthread_t* workers;
+   pthread_t out;
+   Engine e = hsh_engine;
+   int threads = DEFAULT_THREADS, chunk_kb = DEFAULT_CHUNK_KB, i, a;
+   const char* wordlist = NULL;
+   const char* textfile = NULL;
+   FILE* in = stdin;
+   long num_dict;
+   double t0, t1, t2;
+   bool found;
+
+   for (a = 1; a < argc; a++){
+      if ( strcmp(argv[a], "-e") == 0 && a + 1 < argc ){
+         a++;
+         found = false;
+         for (i = 0; i < (int) (sizeof(engines) / sizeof(engines[0])); i++){
+            if ( strcmp(argv[a], engines[i].name) == 0 ){
+               e = engines[i].e;
+               found = true;
+            }
+         }
+         if ( !found ){
+            ON_ERROR("Spell: unknown engine\n");
+         }
+      } else if ( strcmp(argv[a], "-t") == 0 && a + 1 < argc ){
+         threads = atoi(argv[++a]);
+      } else if ( strcmp(argv[a], "-c") == 0 && a + 1 < argc ){
+         chunk_kb = atoi(argv[++a]);
+      } else if ( wordlist == NULL ){
+         wordlist = argv[a];
+      } else {
+         textfile = argv[a];
+      }
+   }
+
+   if ( wordlist == NULL || threads < 1 || chunk_kb < 1 ){
+      ON_ERROR("Usage: spell [-e engine] [-t threads] [-c chunk_kb] "
+               "wordlist [text]\n");
+   }
+
+   if ( e == bst_splay_engine ){
+      threads = 1; /*splaying changes the tree on every lookup*/
+   }
+
+   if ( textfile != NULL ){
+      in = fopen(textfile, "rb");
+      if ( in == NULL ){
+         ON_ERROR("Spell: can't open text\n");
+      }
+   }
+
+   t0 = now_secs();
+   memset(&p, 0, sizeof(pipe_state));
+   p.d = load_words(wordlist, e, &num_dict);
+   t1 = now_secs();
+
+   p.ring_len = threads * CHUNKS_PER_THREAD;
+   p.ring = (chunk**) calloc(p.ring_len, sizeof(chunk*));
+   workers = (pthread_t*) malloc(threads * sizeof(pthread_t));
+   if ( p.ring == NULL || workers == NULL ){
+      ON_ERROR("Spell: allocation failed\n");
+   }
+   pthread_mutex_init(&p.lock, NULL);
+   pthread_cond_init(&p.cond, NULL);
+
+   for (i = 0; i < threads; i++){
+      pthread_create(&workers[i], NULL, worker, &p);
+   }
+   pthread_create(&out, NULL, writer, &p);
+
+   read_input(&p, in, (size_t) chunk_kb * 1024);
+
+   for (i = 0; i < threads; i++){
+      pthread_join(workers[i], NULL);
+   }
+   pthread_join(out, NULL);
+   t2 = now_secs();
+
+   fprintf(stderr, "engine %s, %d threads, %ld dictionary words loaded in "
+           "%.3fs\n", dic_engine_name(p.d), threads, num_dict, t1 - t0);
+   fprintf(stderr, "%lld bytes, %ld words, %ld misspelled in %.3fs: "
+           "%.1f MB/s\n", p.num_bytes, p.num_words, p.num_miss, t2 - t1,
+           t2 > t1 ? p.num_bytes / 1e6 / (t2 - t1) : 0.0);
+
+   if ( in != stdin ){
+      fclose(in);
+   }
+   pthread_mutex_destroy(&p.lock);
+   pthread_cond_destroy(&p.cond);
+   free(workers);
+   free(p.ring);
+   dic_free(&p.d);
+   return 0;
+}
+
+static dic* load_words(const char* path, Engine e, long* num)
+{
+   /*one word per line, lowered like the words of the text*/
+   FILE* f = fopen(path, "r");
+   char line[1024];
+   dic* d;
+   size_t i;
+
+   if ( f == NULL ){
+      ON_ERROR("Spell: can't open word list\n");
+   }
+
+   d = dic_init(MAXWORD, e);
+   *num = 0;
+   while ( fgets(line, sizeof(line), f) != NULL ){
+      for (i = 0; line[i] != '\0' && line[i] != '\n' && line[i] != '\r'; i++){
+         line[i] = (char) tolower((unsigned char) line[i]);
+      }
+      line[i] = '\0';
+      if ( i > 0 ){
+         dic_insert(d, line);
+         (*num)++;
+      }
+   }
+
+   fclose(f);
+   return d;
+}
+
+static void read_input(pipe_state* p, FILE* in, size_t chunk_len)
+{
+   /*reads chunk_len bytes at a time, hands on everything up to the
+     last word boundary and carries the rest into the next chunk   */
+   char* carry = NULL;
+   size_t carry_len = 0, got, cut;
+   long long base = 0;
+   chunk* c;
+
+   for (;;){
+      c = (chunk*) calloc(1, sizeof(chunk));
+      if ( c == NULL ){
+         ON_ERROR("Spell: allocation failed\n");
+      }
+      c->text = (char*) malloc(carry_len + chunk_len);
+      if ( c->text == NULL ){
+         ON_ERROR("Spell: allocation failed\n");
+      }
+      if ( carry_len > 0 ){
+         memcpy(c->text, carry, carry_len);
+      }
+      free(carry);
+      carry = NULL;
+
+      got = fread(c->text + carry_len, 1, chunk_len, in);
+      c->len = carry_len + got;
+      carry_len = 0;
+
+      if ( got > 0 ){
+         /*a chunk that is one long word is taken whole*/
+         cut = c->len;
+         while ( cut > 0 && (isalpha((unsigned char) c->text[cut - 1]) ||
+                             c->text[cut - 1] == '\'') ){
+            cut--;
+         }
+         if ( cut > 0 && cut < c->len ){
+            carry_len = c->len - cut;
+            carry = (char*) malloc(carry_len);
+            if ( carry == NULL ){
+               ON_ERROR("Spell: allocation failed\n");
+            }
+            memcpy(carry, c->text + cut, carry_len);
+            c->len = cut;
+         }
+      }
+
+      if ( c->len == 0 ){
+         free_chunk(c);
+         break;
+      }
+
+      c->base = base;
+      base += c->len;
+
+      pthread_mutex_lock(&p->lock);
+      while ( p->next_read - p->next_write >= p->ring_len ){
+         pthread_cond_wait(&p->cond, &p->lock);
+      }
+      c->seq = p->next_read;
+      p->ring[c->seq % p->ring_len] = c;
+      p->next_read++;
+      p->num_bytes += c->len;
+      pthread_cond_broadcast(&p->cond);
+      pthread_mutex_unlock(&p->lock);
+
+      if ( got == 0 ){
+         break; /*last carry handed on*/
+      }
+   }
+
+   pthread_mutex_lock(&p->lock);
+   p->eof = true;
+   pthread_cond_broadcast(&p->cond);
+   pthread_mutex_unlock(&p->lock);
+}
+
+static void* worker(void* arg)
+{
+   pipe_state* p = (pipe_state*) arg;
+   batch b;
+   chunk* c;
+
+   memset(&b, 0, sizeof(batch));
+
+   for (;;){
+      pthread_mutex_lock(&p->lock);
+      while ( p->next_work == p->next_read && !p->eof ){
+         pthread_cond_wait(&p->cond, &p->lock);
+      }
+      if ( p->next_work == p->next_read ){
+         pthread_mutex_unlock(&p->lock);
+         break;
+      }
+      c = p->ring[p->next_work % p->ring_len];
+      p->next_work++;
+      pthread_mutex_unlock(&p->lock);
+
+      check_chunk(p->d, c, &b);
+
+      pthread_mutex_lock(&p->lock);
+      c->done = true;
+      pthread_cond_broadcast(&p->cond);
+      pthread_mutex_unlock(&p->lock);
+   }
+
+   free(b.words);
+   free(b.offs);
+   free(b.lens);
+   return NULL;
+}
+
+static void* writer(void* arg)
+{
+   /*prints chunk next_write as soon as it is done, in input order*/
+   pipe_state* p = (pipe_state*) arg;
+   chunk* c;
+   int i;
+
+   for (;;){
+      pthread_mutex_lock(&p->lock);
+      while ( (p->next_write == p->next_read && !p->eof) ||
+              (p->next_write < p->next_read &&
+               !p->ring[p->next_write % p->ring_len]->done) ){
+         pthread_cond_wait(&p->cond, &p->lock);
+      }
+      if ( p->next_write == p->next_read ){
+         pthread_mutex_unlock(&p->lock);
+         break;
+      }
+      c = p->ring[p->next_write % p->ring_len];
+      pthread_mutex_unlock(&p->lock);
+
+      for (i = 0; i < c->num_miss; i++){
+         printf("%lld\t%.*s\n", c->base + (long long) c->misses[i].off,
+                c->misses[i].len, c->text + c->misses[i].off);
+      }
+
+      pthread_mutex_lock(&p->lock);
+      p->num_words += c->num_words;
+      p->num_miss += c->num_miss;
+      p->ring[p->next_write % p->ring_len] = NULL;
+      p->next_write++;
+      pthread_cond_broadcast(&p->cond);
+      pthread_mutex_unlock(&p->lock);
+
+      free_chunk(c);
+   }
+
+   fflush(stdout);
+   return NULL;
+}
+
+static void check_chunk(dic* d, chunk* c, batch* b)
+{
+   /*tokenize the whole chunk first, then one pass of lookups*/
+   char w[MAXWORD];
+   size_t i = 0, start;
+   int len, k;
+
+   b->len = 0;
+   while ( i < c->len ){
+      if ( !is_word_char(c->text, i, c->len) ){
+         i++;
+         continue;
+      }
+      start = i;
+      len = 0;
+      while ( i < c->len && is_word_char(c->text, i, c->len) ){
+         if ( len < MAXWORD - 1 ){
+            w[len++] = (char) tolower((unsigned char) c->text[i]);
+         }
+         i++;
+      }
+      w[len] = '\0';
+      add_word(b, w, start, (int) (i - start));
+   }
+
+   c->num_words = b->len;
+   for (k = 0; k < b->len; k++){
+      if ( !dic_isin(d, b->words + (size_t) k * MAXWORD) ){
+         add_miss(c, b->offs[k], b->lens[k]);
+      }
+   }
+}
+
+static void add_word(batch* b, const char* w, size_t off, int len)
+{
+   if ( b->len == b->cap ){
+      b->cap = b->cap ? b->cap * 2 : 4096;
+      b->words = (char*) realloc(b->words, (size_t) b->cap * MAXWORD);
+      b->offs = (size_t*) realloc(b->offs, b->cap * sizeof(size_t));
+      b->lens = (int*) realloc(b->lens, b->cap * sizeof(int));
+      if ( b->words == NULL || b->offs == NULL || b->lens == NULL ){
+         ON_ERROR("Spell: allocation failed\n");
+      }
+   }
+   strcpy(b->words + (size_t) b->len * MAXWORD, w);
+   b->offs[b->len] = off;
+   b->lens[b->len] = len;
+   b->len++;
+}
+
+static void add_miss(chunk* c, size_t off, int len)
+{
+   if ( c->num_miss == c->cap_miss ){
+      c->cap_miss = c->cap_miss ? c->cap_miss * 2 : 64;
+      c->misses = (miss*) realloc(c->misses, c->cap_miss * sizeof(miss));
+      if ( c->misses == NULL ){
+         ON_ERROR("Spell: allocation failed\n");
+      }
+   }
+   c->misses[c->num_miss].off = off;
+   c->misses[c->num_miss].len = len;
+   c->num_miss++;
+}
+
+static bool is_word_char(const char* text, size_t i, size_t len)
+{
+   /*letters, and an apostrophe between two letters (don't)*/
+   if ( isalpha((unsigned char) text[i]) ){
+      return true;
+   }
+   return text[i] == '\'' && i > 0 && i + 1 < len &&
+          isalpha((unsigned char) text[i - 1]) &&
+          isalpha((unsigned char) text[i + 1]) ? true : false;
+}
+
+static void free_chunk(chunk* c)
+{
+   free(c->text);
+   free(c->misses);
+   free(c);
+}
+
+static double now_secs(void)
+{
+   struct timespec t;
+
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec + t.tv_nsec / 1e9;
+}
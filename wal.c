@@ -0,0 +1,514 @@
+/***************************************
+ *          WRITE AHEAD LOG            *
+ *_____________________________________*
+ * - every insert that adds a word and *
+ *   every removal that takes one is a *
+ *   record: op, 16 bit length, word,  *
+ *   32 bit checksum                   *
+ * - records collect in a WAL_BUF      *
+ *   buffer; batch of them share one   *
+ *   write and one fdatasync           *
+ * - a snapshot is every word written  *
+ *   the same way to a temporary file  *
+ *   and renamed over path.snap, then  *
+ *   the log starts again empty        *
+ * - recovery loads the snapshot and   *
+ *   replays the log in WAL_BUF reads; *
+ *   a torn last record is cut off     *
+ *_____________________________________*
+ ***************************************/
+#define _GNU_SOURCE /*fdatasync, ftruncate*/
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "wal.h"
+#include "hsh.h"
+
+#define WAL_MAGIC "DICWAL1\n"
+#define MAGIC_LEN 8
+#define REC_HEAD 3          /*op and length*/
+#define REC_SUM 4
+#define OP_INSERT 'I'
+#define OP_REMOVE 'R'
+#define COMPACT_MIN (1L << 20) /*smaller logs are never folded*/
+
+static const uint64_t wal_seed[2] = {0x6c6f67736e6170ULL, 0x646963776c6f67ULL};
+
+/*writer*/
+static void out_open(wal_out* o, const char* path, int flags);
+static void out_magic(wal_out* o);
+static void out_record(wal_out* o, char op, char* v, size_t len);
+static void out_flush(wal_out* o);
+static void out_sync(wal_out* o);
+static void out_close(wal_out* o);
+
+/*recovery*/
+static long replay(wal* w, const char* path, long* size,
+                   unsigned long* records);
+static size_t record_len(const unsigned char* p, size_t avail);
+
+/*helper*/
+static void log_op(wal* w, char op, char* v);
+static void commit(wal* w);
+static void maybe_compact(wal* w);
+static void save_word(char* v, void* arg);
+static uint32_t rec_sum(const unsigned char* rec, size_t n);
+static size_t word_len(wal* w, char* v);
+static char* path_with(const char* path, const char* ext);
+static void sync_dir(const char* path);
+
+/* Opens the dic logged at path, or a new empty one */
+wal* wal_open(const char* path, int size, Engine e, int batch)
+{
+   wal* w = NULL;
+   long good, log_size = 0;
+
+   if ( path == NULL || batch < 1 ){
+      ON_ERROR("Wal_open() needs a path and batch >= 1\n");
+   }
+   if ( size - 1 > WAL_MAX_WORD ){
+      ON_ERROR("Wal_open() size is past WAL_MAX_WORD\n");
+   }
+
+   w = (wal*) calloc(1, sizeof(wal));
+   if ( w == NULL ){
+      ON_ERROR("Creation of Write Ahead Log Failed\n");
+   }
+
+   w->d = dic_init(size, e);
+   w->max_str = size;
+   w->batch = batch;
+   w->log_path = path_with(path, "");
+   w->snap_path = path_with(path, ".snap");
+   w->word = (char*) malloc(size);
+   if ( w->word == NULL ){
+      ON_ERROR("Creation of Write Ahead Log Failed\n");
+   }
+
+   /*a snapshot only ever appears whole (rename), so damage is fatal*/
+   good = replay(w, w->snap_path, &w->snap_bytes, NULL);
+   if ( good >= 0 && good < w->snap_bytes ){
+      ON_ERROR("Wal_open() snapshot is damaged\n");
+   }
+
+   good = replay(w, w->log_path, &log_size, &w->num_replayed);
+   out_open(&w->log, w->log_path, O_WRONLY | O_CREAT | O_APPEND);
+   if ( good < MAGIC_LEN ){
+      /*new, or the crash came before the header was down*/
+      if ( ftruncate(w->log.fd, 0) != 0 ){
+         ON_ERROR("Wal_open() can't reset the log\n");
+      }
+      out_magic(&w->log);
+      commit(w);
+   } else {
+      if ( good < log_size ){
+         /*the last batch was cut short, it never committed*/
+         if ( ftruncate(w->log.fd, good) != 0 ){
+            ON_ERROR("Wal_open() can't cut the torn log tail\n");
+         }
+         out_sync(&w->log);
+         w->torn_bytes = log_size - good;
+      }
+      w->log.bytes = good;
+   }
+
+   maybe_compact(w);
+   return w;
+}
+
+/* Adds v, logged if it is new */
+void wal_insert(wal* w, char* v)
+{
+   int before;
+
+   if ( w == NULL || v == NULL || word_len(w, v) == 0 ){
+      return;
+   }
+
+   /*duplicates change nothing, so they aren't logged*/
+   before = dic_size(w->d);
+   dic_insert(w->d, v);
+   if ( dic_size(w->d) != before ){
+      log_op(w, OP_INSERT, v);
+   }
+}
+
+/* Removes v, returns true (and logs it) if it was in */
+bool wal_remove(wal* w, char* v)
+{
+   if ( w == NULL || v == NULL ){
+      return false;
+   }
+
+   if ( !dic_remove(w->d, v) ){
+      return false;
+   }
+   log_op(w, OP_REMOVE, v);
+   return true;
+}
+
+/* Writes and fdatasyncs the records of an unfinished batch */
+void wal_commit(wal* w)
+{
+   if ( w == NULL ){
+      return;
+   }
+   commit(w);
+}
+
+/* Writes every word to a new snapshot and empties the log */
+void wal_snapshot(wal* w)
+{
+   char* tmp;
+   wal_out o;
+
+   if ( w == NULL ){
+      return;
+   }
+
+   commit(w);
+
+   tmp = path_with(w->snap_path, ".tmp");
+   out_open(&o, tmp, O_WRONLY | O_CREAT | O_TRUNC);
+   out_magic(&o);
+   dic_foreach(w->d, save_word, &o);
+   out_flush(&o);
+   out_sync(&o);
+   out_close(&o);
+
+   if ( rename(tmp, w->snap_path) != 0 ){
+      ON_ERROR("Wal_snapshot() can't replace the snapshot\n");
+   }
+   sync_dir(w->snap_path);
+   w->snap_bytes = o.bytes;
+   free(tmp);
+
+   /*a crash before the log is emptied replays it over the new
+     snapshot: each word ends as its last record says, which is
+     what the snapshot already holds                            */
+   if ( ftruncate(w->log.fd, 0) != 0 ){
+      ON_ERROR("Wal_snapshot() can't empty the log\n");
+   }
+   w->log.bytes = 0;
+   out_magic(&w->log);
+   commit(w);
+   w->num_snapshots++;
+}
+
+/* Snapshot whenever the log passes bytes, 0 auto, -1 never */
+void wal_set_compact(wal* w, long bytes)
+{
+   if ( w == NULL ){
+      return;
+   }
+   w->compact_at = bytes;
+}
+
+/* Commits, closes the log and clears all space, sets pointer to NULL */
+void wal_free(wal** w)
+{
+   wal* p_w;
+
+   if ( w == NULL ){
+      return;
+   }
+
+   p_w = *w;
+   if ( p_w == NULL ){
+      return;
+   }
+
+   commit(p_w);
+   out_close(&p_w->log);
+   dic_free(&p_w->d);
+   free(p_w->log_path);
+   free(p_w->snap_path);
+   free(p_w->word);
+   free(p_w);
+   *w = NULL;
+}
+
+static void out_open(wal_out* o, const char* path, int flags)
+{
+   memset(o, 0, sizeof(wal_out));
+   o->fd = open(path, flags, 0644);
+   o->buf = (char*) malloc(WAL_BUF);
+   if ( o->fd < 0 || o->buf == NULL ){
+      ON_ERROR("Opening the log failed\n");
+   }
+}
+
+static void out_magic(wal_out* o)
+{
+   memcpy(o->buf + o->len, WAL_MAGIC, MAGIC_LEN);
+   o->len += MAGIC_LEN;
+   o->bytes += MAGIC_LEN;
+}
+
+static void out_record(wal_out* o, char op, char* v, size_t len)
+{
+   unsigned char* p;
+   uint32_t sum;
+   size_t n = REC_HEAD + len + REC_SUM;
+
+   if ( o->len + n > WAL_BUF ){
+      out_flush(o);
+   }
+
+   p = (unsigned char*) o->buf + o->len;
+   p[0] = (unsigned char) op;
+   p[1] = (unsigned char) (len & 0xff);
+   p[2] = (unsigned char) (len >> 8);
+   memcpy(p + REC_HEAD, v, len);
+   sum = rec_sum(p, REC_HEAD + len);
+   p[REC_HEAD + len] = (unsigned char) sum;
+   p[REC_HEAD + len + 1] = (unsigned char) (sum >> 8);
+   p[REC_HEAD + len + 2] = (unsigned char) (sum >> 16);
+   p[REC_HEAD + len + 3] = (unsigned char) (sum >> 24);
+
+   o->len += n;
+   o->bytes += (long) n;
+}
+
+static void out_flush(wal_out* o)
+{
+   size_t off = 0;
+   ssize_t got;
+
+   while ( off < o->len ){
+      got = write(o->fd, o->buf + off, o->len - off);
+      if ( got < 0 && errno == EINTR ){
+         continue;
+      }
+      if ( got < 0 ){
+         ON_ERROR("Writing the log failed\n");
+      }
+      off += (size_t) got;
+   }
+   o->len = 0;
+}
+
+static void out_sync(wal_out* o)
+{
+   if ( fdatasync(o->fd) != 0 ){
+      ON_ERROR("Syncing the log failed\n");
+   }
+}
+
+static void out_close(wal_out* o)
+{
+   if ( o->fd >= 0 ){
+      close(o->fd);
+   }
+   o->fd = -1;
+   free(o->buf);
+   o->buf = NULL;
+}
+
+static long replay(wal* w, const char* path, long* size,
+                   unsigned long* records)
+{
+   /*applies the good records of path, returns how many bytes they
+     (and the header) take, or -1 if there is no such file. Reads
+     WAL_BUF at a time; a record cut by a read waits for the next */
+   unsigned char* chunk;
+   struct stat st;
+   size_t have = 0, at, n, len;
+   ssize_t got;
+   long good = 0;
+   bool bad = false;
+   void* hint = NULL;
+   int fd = open(path, O_RDONLY);
+
+   if ( fd < 0 && errno == ENOENT ){
+      *size = 0;
+      return -1;
+   }
+   if ( fd < 0 || fstat(fd, &st) != 0 ){
+      ON_ERROR("Opening the log failed\n");
+   }
+   *size = (long) st.st_size;
+
+   chunk = (unsigned char*) malloc(WAL_BUF);
+   if ( chunk == NULL ){
+      ON_ERROR("Log replay allocation failed\n");
+   }
+
+   while ( !bad ){
+      got = read(fd, chunk + have, WAL_BUF - have);
+      if ( got < 0 && errno == EINTR ){
+         continue;
+      }
+      if ( got < 0 ){
+         ON_ERROR("Reading the log failed\n");
+      }
+      have += (size_t) got;
+      at = 0;
+
+      if ( good == 0 ){
+         if ( have < MAGIC_LEN ){
+            if ( got == 0 ){
+               break;
+            }
+            continue;
+         }
+         if ( memcmp(chunk, WAL_MAGIC, MAGIC_LEN) != 0 ){
+            ON_ERROR("Wal_open() found a file that isn't a dic log\n");
+         }
+         at = MAGIC_LEN;
+         good = MAGIC_LEN;
+      }
+
+      while ( (n = record_len(chunk + at, have - at)) > 0 ){
+         len = n - REC_HEAD - REC_SUM;
+         if ( rec_sum(chunk + at, REC_HEAD + len) !=
+              ((uint32_t) chunk[at + n - 4] |
+               (uint32_t) chunk[at + n - 3] << 8 |
+               (uint32_t) chunk[at + n - 2] << 16 |
+               (uint32_t) chunk[at + n - 1] << 24) ){
+            bad = true;
+            break;
+         }
+
+         if ( len > (size_t) w->max_str - 1 ){
+            len = w->max_str - 1;
+         }
+         memcpy(w->word, chunk + at + REC_HEAD, len);
+         w->word[len] = '\0';
+         if ( chunk[at] == OP_INSERT ){
+            /*snapshots of the tree engines come sorted*/
+            hint = dic_insert_hint(w->d, w->word, hint);
+         } else if ( chunk[at] == OP_REMOVE ){
+            dic_remove(w->d, w->word);
+            hint = NULL;
+         } else {
+            bad = true;
+            break;
+         }
+
+         if ( records != NULL ){
+            (*records)++;
+         }
+         at += n;
+         good += (long) n;
+      }
+
+      memmove(chunk, chunk + at, have - at);
+      have -= at;
+      if ( got == 0 ){
+         break;
+      }
+   }
+
+   free(chunk);
+   close(fd);
+   return good;
+}
+
+static size_t record_len(const unsigned char* p, size_t avail)
+{
+   /*bytes of the record at p, 0 while it isn't all in*/
+   size_t n;
+
+   if ( avail < REC_HEAD ){
+      return 0;
+   }
+   n = REC_HEAD + ((size_t) p[1] | (size_t) p[2] << 8) + REC_SUM;
+   return n <= avail ? n : 0;
+}
+
+static void log_op(wal* w, char op, char* v)
+{
+   out_record(&w->log, op, v, word_len(w, v));
+   w->pending++;
+   if ( w->pending >= w->batch ){
+      commit(w);
+      maybe_compact(w);
+   }
+}
+
+static void commit(wal* w)
+{
+   if ( w->pending == 0 && w->log.len == 0 ){
+      return;
+   }
+   out_flush(&w->log);
+   out_sync(&w->log);
+   w->pending = 0;
+   w->num_commits++;
+}
+
+static void maybe_compact(wal* w)
+{
+   /*folding once the log outgrows the snapshot keeps replay under
+     the snapshot's size and costs O(1) amortized per record      */
+   if ( w->compact_at < 0 ){
+      return;
+   }
+   if ( w->compact_at > 0 ? w->log.bytes > w->compact_at :
+        w->log.bytes > COMPACT_MIN && w->log.bytes > w->snap_bytes ){
+      wal_snapshot(w);
+   }
+}
+
+static void save_word(char* v, void* arg)
+{
+   out_record((wal_out*) arg, OP_INSERT, v, strlen(v));
+}
+
+static uint32_t rec_sum(const unsigned char* rec, size_t n)
+{
+   return (uint32_t) hsh_siphash((const char*) rec, n, wal_seed);
+}
+
+static size_t word_len(wal* w, char* v)
+{
+   /*what the engines keep: max_str - 1 bytes at most*/
+   size_t len = strlen(v);
+
+   if ( len > (size_t) w->max_str - 1 ){
+      len = w->max_str - 1;
+   }
+   return len;
+}
+
+static char* path_with(const char* path, const char* ext)
+{
+   char* p = (char*) malloc(strlen(path) + strlen(ext) + 1);
+
+   if ( p == NULL ){
+      ON_ERROR("Log path allocation failed\n");
+   }
+   strcpy(p, path);
+   strcat(p, ext);
+   return p;
+}
+
+static void sync_dir(const char* path)
+{
+   /*makes the rename itself durable*/
+   char* dir = path_with(path, "");
+   char* slash = strrchr(dir, '/');
+   int fd;
+
+   if ( slash == NULL ){
+      strcpy(dir, ".");
+   } else if ( slash == dir ){
+      slash[1] = '\0';
+   } else {
+      *slash = '\0';
+   }
+
+   fd = open(dir, O_RDONLY);
+   if ( fd < 0 ){
+      ON_ERROR("Opening the log directory failed\n");
+   }
+   if ( fsync(fd) != 0 ){
+      ON_ERROR("Syncing the log directory failed\n");
+   }
+   close(fd);
+   free(dir);
+}
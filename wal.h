@@ -0,0 +1,73 @@
+/**********************************
+ *   Write Ahead Log H file       *
+ *________________________________*
+ * a dic that survives restarts:  *
+ * inserts and removals go to an  *
+ * append only log, committed in  *
+ * groups, folded into a snapshot *
+ * once the log outgrows it       *
+ **********************************/
+#ifndef WAL_H
+#define WAL_H
+
+#include <stddef.h>
+#include "dic.h"
+
+#define WAL_BUF (1 << 17)     /*write buffer and replay chunk*/
+#define WAL_MAX_WORD 65535    /*record lengths are 16 bit*/
+
+/*buffered writer, for the log and for snapshots*/
+struct _wal_out {
+   int fd;
+   char* buf;    /*records not yet written, WAL_BUF bytes*/
+   size_t len;
+   long bytes;   /*file size, buffered records included*/
+};
+typedef struct _wal_out wal_out;
+
+struct _wal {
+   dic* d;            /*read it directly, change it only through wal_*/
+   char* log_path;    /*path as given*/
+   char* snap_path;   /*path + ".snap"*/
+   wal_out log;       /*opened for append*/
+   int max_str;
+   int batch;         /*records per group commit*/
+   int pending;       /*records since the last fdatasync*/
+   char* word;        /*replay scratch, max_str bytes*/
+   long snap_bytes;
+   long compact_at;   /*0: once the log is bigger than the snapshot*/
+   /*stats*/
+   unsigned long num_commits;
+   unsigned long num_snapshots;
+   unsigned long num_replayed; /*log records applied by wal_open*/
+   long torn_bytes;            /*partial tail cut off by wal_open*/
+};
+typedef struct _wal wal;
+
+/* Opens the dic logged at path, or a new empty one: loads
+   path.snap, then replays the log after it. Words of size max_str
+   go in a dic of engine e; every batch records are made durable
+   together (1 = each one) */
+wal* wal_open(const char* path, int size, Engine e, int batch);
+
+/* Adds v, logged if it is new */
+void wal_insert(wal* w, char* v);
+
+/* Removes v, returns true (and logs it) if it was in. Always false
+   for engines without removal */
+bool wal_remove(wal* w, char* v);
+
+/* Writes and fdatasyncs the records of an unfinished batch */
+void wal_commit(wal* w);
+
+/* Writes every word to a new snapshot and empties the log */
+void wal_snapshot(wal* w);
+
+/* Snapshot whenever the log passes bytes; 0 (the default) waits
+   until it is bigger than the snapshot, -1 leaves it to the caller */
+void wal_set_compact(wal* w, long bytes);
+
+/* Commits, closes the log and clears all space, sets pointer to NULL */
+void wal_free(wal** w);
+
+#endif